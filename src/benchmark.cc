@@ -0,0 +1,643 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "game_state.h"
+#include "search.h"
+#include "time_control.h"
+#include "gtp.h"
+#include "evaluator.h"
+#include "cpu_backend.h"
+#include "ladder.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void benchmark_all() {
+    benchmark_board(0.5);
+    benchmark_perft(3);
+    benchmark_playouts(2.0);
+    benchmark_ladders(1.0);
+    benchmark_search_scaling(2.0);
+    benchmark_gtp(2.0);
+    benchmark_evaluator(2.0);
+    benchmark_network(1.0);
+}
+
+bool benchmark_suite(const std::string &name) {
+    if (name == "all") {
+        benchmark_all();
+    } else if (name == "board") {
+        benchmark_board(1.0);
+    } else if (name == "perft") {
+        benchmark_perft(8);
+    } else if (name == "playouts") {
+        benchmark_playouts(2.0);
+    } else if (name == "ladders") {
+        benchmark_ladders(1.0);
+    } else if (name == "search") {
+        benchmark_search_scaling(2.0);
+    } else if (name == "gtp") {
+        benchmark_gtp(2.0);
+    } else if (name == "evaluator") {
+        benchmark_evaluator(2.0);
+    } else if (name == "network") {
+        benchmark_network(1.0);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Transfer the GTP text like "D4" to the vertex.
+static int text_to_vertex(const Board &board, const std::string &text) {
+    const char *x_lable_map = "ABCDEFGHJKLMNOPQRST";
+    const int x = std::find(x_lable_map, x_lable_map + 19, text[0]) - x_lable_map;
+    const int y = std::stoi(text.substr(1)) - 1;
+    return board.get_vertex(x, y);
+}
+
+static std::uint64_t perft(Board &board, int depth,
+                               std::vector<std::vector<int>> &buffers) {
+    auto &moves = buffers[depth];
+    const int color = board.get_tomove();
+    board.legal_moves(color, moves);
+    if (depth == 1) {
+        return moves.size();
+    }
+
+    std::uint64_t leaves = 0;
+    for (const auto vtx : moves) {
+        board.play_move_assume_legal(vtx, color);
+        leaves += perft(board, depth - 1, buffers);
+        board.undo_move();
+    }
+    return leaves;
+}
+
+std::uint64_t perft(Board &board, int depth) {
+    if (depth <= 0) {
+        return 1;
+    }
+    std::vector<std::vector<int>> buffers(depth + 1);
+    return perft(board, depth, buffers);
+}
+
+// The fixed positions of perft. They are played from the move list, not
+// generated, so the counts never change with the board code. The counts
+// were checked against a perft which copies the board instead of undo.
+struct PerftPosition {
+    const char *name;
+    int board_size;
+    const char *moves;
+
+    // The deepest perft, about a few seconds.
+    int max_depth;
+
+    // The known counts of depth 1, 2, ...
+    std::uint64_t counts[8];
+};
+
+static const PerftPosition PERFT_POSITIONS[] = {
+    {"9x9 empty", 9, "", 4,
+     {81, 6480, 511920, 39929136}},
+    {"5x5 fight", 5, "A5 B2 E3 E2 B3 D4 B4 E1 C1 C2 D5 D1 C5 B1", 8,
+     {11, 109, 980, 7818, 55437, 346110, 1892251, 9274552}},
+    {"9x9 end game", 9,
+     "F4 A1 A2 C9 H5 F2 E9 D5 A9 E8 B5 G6 G3 F6 C1 E7 F9 J2 C3 D6 "
+     "J6 C7 J9 H6 D8 C8 G4 G1 D7 B8 J1 A5 G5 E6 A4 H7 H4 A8 G9 B9 "
+     "F5 C5 B2 H2 A7 B3 E1 G7 E4 A3 J3 H3 D2 B6 F3 H9 D3 J8 B7 B4 "
+     "G2 F8 B1 H1 E2 A6 E5 G8 A7 F1", 7,
+     {10, 141, 1403, 20641, 226128, 3560372, 42821372}},
+    {"19x19 opening", 19,
+     "T11 S11 P3 J18 E17 S14 O17 R10 F13 K11 Q9 N5 O14 Q19 P6 H2 B3 L2 A15 K16 "
+     "N9 L12 S3 F12 L9 R16 G13 N11 R7 L16 P7 D15 M3 S8 H19 O10 R4 K2 Q3 J19", 3,
+     {321, 102719, 32767361}}
+};
+
+bool benchmark_perft(int depth) {
+    bool correct = true;
+    for (const auto &position : PERFT_POSITIONS) {
+        if (position.board_size > Board::BOARD_SIZE) {
+            continue;
+        }
+        Board board;
+        board.reset_board(position.board_size);
+
+        auto moves = std::istringstream{position.moves};
+        auto text = std::string{};
+        while (moves >> text) {
+            const int color = board.get_tomove();
+            board.play_move_assume_legal(text_to_vertex(board, text), color);
+        }
+        board.clear_undo();
+
+        for (int d = 1; d <= std::min(depth, position.max_depth); ++d) {
+            const auto start = Clock::now();
+            const auto leaves = perft(board, d);
+            const double time = elapsed_seconds(start);
+
+            const bool match = position.counts[d-1] == leaves;
+            correct &= match;
+
+            std::cout << position.name << " perft " << d << ": " << leaves << " leaves"
+                          << (match ? " (ok)" : " (WRONG)")
+                          << " in " << std::fixed << std::setprecision(3) << time << " sec, "
+                          << static_cast<long long>(leaves / std::max(time, 1e-9)) << " leaves/sec"
+                          << std::endl;
+        }
+    }
+    return correct;
+}
+
+// The recorded random games of one board size.
+struct BoardBenchmarkGames {
+    // The moves and colors of each game.
+    std::vector<std::vector<std::pair<int, int>>> games;
+
+    // The boards in the middle of the games and the rest of the moves,
+    // the capture heavy part.
+    std::vector<Board> middle_boards;
+    std::vector<std::vector<std::pair<int, int>>> end_moves;
+    long long end_captures;
+
+    // The positions every ten moves.
+    std::vector<Board> positions;
+
+    // The final positions.
+    std::vector<GameState> final_states;
+};
+
+static void record_games(int board_size, int num_games, BoardBenchmarkGames &record) {
+    record.end_captures = 0;
+    for (int g = 0; g < num_games; ++g) {
+        GameState state;
+        state.clear_board(board_size, 7.5f);
+
+        std::vector<std::pair<int, int>> game;
+        std::vector<std::pair<int, int>> end_moves;
+        const int middle = board_size * board_size;
+
+        while (state.get_passes() < 2 && state.get_movenum() < 3 * middle) {
+            if (state.get_movenum() == middle) {
+                record.middle_boards.emplace_back(state.board);
+                record.middle_boards.back().clear_undo();
+            }
+            if (state.get_movenum() % 10 == 0) {
+                record.positions.emplace_back(state.board);
+                record.positions.back().clear_undo();
+            }
+            const int color = state.get_tomove();
+            const int empty_cnt = state.board.get_empty_count();
+            const int vtx = state.play_random_move(color);
+            game.emplace_back(vtx, color);
+
+            if (state.get_movenum() > middle) {
+                end_moves.emplace_back(vtx, color);
+                if (vtx != Board::PASS) {
+                    record.end_captures += state.board.get_empty_count() - (empty_cnt - 1);
+                }
+            }
+        }
+        if (state.get_movenum() > middle) {
+            record.end_moves.emplace_back(std::move(end_moves));
+        }
+        record.games.emplace_back(std::move(game));
+        record.final_states.emplace_back(state);
+    }
+}
+
+// Call the step until the seconds pass. The step returns the number of
+// operations. Return the operations per second.
+template<typename Step>
+static double measure_rate(double seconds, Step step) {
+    long long ops = 0;
+    const auto start = Clock::now();
+    do {
+        ops += step();
+    } while (elapsed_seconds(start) < seconds);
+    return ops / elapsed_seconds(start);
+}
+
+static void print_rate(int board_size, const char *name, double rate, const char *unit) {
+    std::cout << board_size << "x" << board_size << " " << name << ": "
+                  << static_cast<long long>(rate) << " " << unit << "/sec" << std::endl;
+}
+
+void benchmark_board(double seconds) {
+    for (int board_size : {9, 13, 19}) {
+        if (board_size > Board::BOARD_SIZE) {
+            continue;
+        }
+        BoardBenchmarkGames record;
+        record_games(board_size, 20, record);
+
+        Board board;
+        const double play_rate = measure_rate(seconds, [&]() {
+            long long moves = 0;
+            for (const auto &game : record.games) {
+                board.reset_board(board_size);
+                for (const auto &move : game) {
+                    board.play_move_assume_legal(move.first, move.second);
+                }
+                moves += game.size();
+            }
+            return moves;
+        });
+        print_rate(board_size, "play", play_rate, "moves");
+
+        // Only the undo part is timed.
+        double undo_time = 0.0;
+        long long undo_moves = 0;
+        while (undo_time < seconds) {
+            for (const auto &game : record.games) {
+                board.reset_board(board_size);
+                for (const auto &move : game) {
+                    board.play_move_assume_legal(move.first, move.second);
+                }
+                const auto start = Clock::now();
+                while (board.undo_move()) {}
+                undo_time += elapsed_seconds(start);
+                undo_moves += game.size();
+            }
+        }
+        print_rate(board_size, "undo", undo_moves / undo_time, "moves");
+
+        long long end_moves = 0;
+        for (const auto &moves : record.end_moves) {
+            end_moves += moves.size();
+        }
+        const double end_rate = measure_rate(seconds, [&]() {
+            for (int i = 0; i < (int)record.end_moves.size(); ++i) {
+                board = record.middle_boards[i];
+                for (const auto &move : record.end_moves[i]) {
+                    board.play_move_assume_legal(move.first, move.second);
+                }
+            }
+            return std::max(end_moves, 1LL);
+        });
+        print_rate(board_size, "capture heavy play", end_rate, "moves");
+        print_rate(board_size, "capture heavy captures",
+                       end_rate * record.end_captures / std::max(end_moves, 1LL), "stones");
+
+        const double legal_rate = measure_rate(seconds, [&]() {
+            long long checks = 0;
+            for (const auto &position : record.positions) {
+                for (int i = 0; i < position.get_empty_count(); ++i) {
+                    const int vtx = position.get_empty(i);
+                    position.legal_move(vtx, Board::BLACK);
+                    position.legal_move(vtx, Board::WHITE);
+                }
+                checks += 2 * position.get_empty_count();
+            }
+            return checks;
+        });
+        print_rate(board_size, "legal_move", legal_rate, "checks");
+
+        const double score_rate = measure_rate(seconds, [&]() {
+            for (auto &state : record.final_states) {
+                state.final_score();
+            }
+            return static_cast<long long>(record.final_states.size());
+        });
+        print_rate(board_size, "final_score", score_rate, "scores");
+
+        const double hash_rate = measure_rate(seconds, [&]() {
+            for (const auto &position : record.positions) {
+                position.compute_hash();
+            }
+            return static_cast<long long>(record.positions.size());
+        });
+        print_rate(board_size, "compute_hash", hash_rate, "hashes");
+
+        GameState state;
+        state.clear_board(board_size, 7.5f);
+        const double playout_rate = measure_rate(seconds, [&]() {
+            for (int i = 0; i < 10; ++i) {
+                state.random_playout();
+            }
+            return 10LL;
+        });
+        print_rate(board_size, "random playouts", playout_rate, "playouts");
+    }
+}
+
+void benchmark_playouts(double seconds) {
+    for (int board_size : {9, 19}) {
+        if (board_size > Board::BOARD_SIZE) {
+            continue;
+        }
+        for (int policy : {GameState::UNIFORM_POLICY, GameState::PATTERN_POLICY}) {
+            GameState state;
+            state.clear_board(board_size, 7.5f);
+            state.set_playout_policy(policy);
+
+            int playouts = 0;
+            int black_wins = 0;
+            const auto start = Clock::now();
+
+            while (elapsed_seconds(start) < seconds) {
+                for (int i = 0; i < 100; ++i) {
+                    if (state.random_playout() > 0.f) {
+                        black_wins++;
+                    }
+                }
+                playouts += 100;
+            }
+            const double time = elapsed_seconds(start);
+
+            std::cout << board_size << "x" << board_size
+                          << (policy == GameState::PATTERN_POLICY ? " pattern" : " random")
+                          << " playouts: "
+                          << playouts << " in " << std::fixed << std::setprecision(2) << time << " sec, "
+                          << static_cast<int>(playouts / time) << " playouts/sec, "
+                          << "black wins " << 100.0 * black_wins / playouts << "%"
+                          << std::endl;
+        }
+    }
+}
+
+void benchmark_ladders(double seconds) {
+    for (int board_size : {9, 19}) {
+        if (board_size > Board::BOARD_SIZE) {
+            continue;
+        }
+
+        // Collect the positions of random games which have a string in
+        // atari or with two liberties.
+        std::vector<Board> positions;
+        std::vector<std::vector<int>> strings;
+        GameState state;
+        while (positions.size() < 200) {
+            state.clear_board(board_size, 7.5f);
+            while (state.get_passes() < 2 && state.get_movenum() < 2 * board_size * board_size) {
+                state.play_random_move(state.get_tomove());
+
+                std::vector<int> position_strings;
+                for (int idx = 0; idx < board_size * board_size; ++idx) {
+                    const int vtx = state.get_vertex(idx % board_size, idx / board_size);
+                    const int stone = state.get_state(vtx);
+                    if ((stone == Board::BLACK || stone == Board::WHITE) &&
+                            state.board.get_liberties(vtx) <= 2) {
+                        position_strings.emplace_back(vtx);
+                    }
+                }
+                if (!position_strings.empty()) {
+                    positions.emplace_back(state.board);
+                    positions.back().clear_undo();
+                    strings.emplace_back(std::move(position_strings));
+                }
+            }
+        }
+
+        long long reads = 0;
+        long long captured = 0;
+        auto start = Clock::now();
+        while (elapsed_seconds(start) < seconds) {
+            for (int i = 0; i < (int)positions.size(); ++i) {
+                auto &board = positions[i];
+                for (const auto vtx : strings[i]) {
+                    const bool dead = board.is_atari(vtx) ?
+                                          Ladder::is_captured(board, vtx) :
+                                          Ladder::is_capturable(board, vtx);
+                    captured += dead;
+                    reads++;
+                }
+            }
+        }
+        const double read_time = elapsed_seconds(start);
+
+        std::vector<float> planes(Ladder::get_planes_size(board_size));
+        long long encodes = 0;
+        start = Clock::now();
+        while (elapsed_seconds(start) < seconds) {
+            for (const auto &board : positions) {
+                Ladder::encode(board, planes.data());
+            }
+            encodes += positions.size();
+        }
+        const double encode_time = elapsed_seconds(start);
+
+        std::cout << board_size << "x" << board_size << " ladder reads: "
+                      << static_cast<long long>(reads / read_time) << " reads/sec, "
+                      << std::fixed << std::setprecision(2) << 1e6 * read_time / reads << " us/read, "
+                      << 100.0 * captured / reads << "% captured, "
+                      << 1e6 * encode_time / encodes << " us/encode"
+                      << std::endl;
+    }
+}
+
+void benchmark_search_scaling(double seconds) {
+    const int board_size = std::min(19, Board::BOARD_SIZE);
+    GameState state;
+    state.clear_board(board_size, 7.5f);
+
+    Search search;
+    search.set_verbose(false);
+    search.set_playouts(0);
+    search.set_time(seconds);
+
+    double base_speed = 0.0;
+    for (int threads : {1, 2, 4, 8, 16}) {
+        search.set_threads(threads);
+        search.think(state, Board::BLACK);
+
+        const double speed = search.get_last_playouts() / search.get_last_elapsed();
+        if (threads == 1) {
+            base_speed = speed;
+        }
+
+        std::cout << board_size << "x" << board_size << " search with "
+                      << std::setw(2) << threads << " threads: "
+                      << static_cast<int>(speed) << " playouts/sec, "
+                      << std::fixed << std::setprecision(2) << speed / base_speed << "x"
+                      << std::endl;
+    }
+}
+
+// Drop everything written to it.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+void benchmark_gtp(double seconds) {
+    const int board_size = std::min(19, Board::BOARD_SIZE);
+    GameState state;
+    state.clear_board(board_size, 7.5f);
+
+    // Record a random game and replay it with play, then take back
+    // every move with undo.
+    auto script = std::ostringstream{};
+    script << "boardsize " << board_size << "\n"
+               << "clear_board\n";
+
+    int moves = 0;
+    while (state.get_passes() < 2 && moves < 4 * board_size * board_size) {
+        int color = state.get_tomove();
+        int vtx = state.play_random_move(color);
+        script << "play " << (color == Board::BLACK ? "b " : "w ")
+                   << state.vertex_to_text(vtx) << "\n";
+        moves++;
+    }
+    for (int i = 0; i < moves; ++i) {
+        script << "undo\n";
+    }
+    script << "protocol_version\n"
+               << "list_commands\n";
+
+    const auto inputs = script.str();
+    auto in = std::istringstream{inputs};
+    NullBuffer null_buffer;
+    std::ostream out(&null_buffer);
+
+    Search search;
+    TimeControl time_control;
+    GameState main_game;
+    main_game.clear_board(board_size, 7.5f);
+
+    long long commands = 0;
+    const auto start = Clock::now();
+
+    while (elapsed_seconds(start) < seconds) {
+        for (int i = 0; i < 10; ++i) {
+            in.clear();
+            in.seekg(0);
+            commands += gtp_run(in, out, &main_game, &search, &time_control);
+        }
+    }
+    const double time = elapsed_seconds(start);
+
+    std::cout << board_size << "x" << board_size << " GTP play/undo: "
+                  << commands << " commands in " << std::fixed << std::setprecision(2) << time << " sec, "
+                  << static_cast<long long>(commands / time) << " commands/sec"
+                  << std::endl;
+}
+
+// Evaluate the positions of random games from the client threads until
+// the time is up. The games restart after the max moves.
+static void run_evaluator(BatchEvaluator &evaluator, int board_size,
+                              int threads, double seconds, const std::string &name,
+                              int max_moves = Board::NUM_VERTICES * 4) {
+    evaluator.reset_counters();
+    if (evaluator.get_cache()) {
+        evaluator.get_cache()->clear();
+    }
+    const auto start = Clock::now();
+    std::atomic<long long> positions{0};
+
+    std::vector<std::thread> clients;
+    for (int t = 0; t < threads; ++t) {
+        clients.emplace_back([&evaluator, &positions, board_size, seconds, start, max_moves]() {
+            GameState state;
+            state.clear_board(board_size, 7.5f);
+            NetResult result;
+
+            while (elapsed_seconds(start) < seconds) {
+                if (state.get_passes() >= 2 || state.get_movenum() >= max_moves) {
+                    state.clear_board(board_size, 7.5f);
+                }
+                evaluator.evaluate(state.board, result);
+                state.play_random_move(state.get_tomove());
+                positions.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto &t : clients) {
+        t.join();
+    }
+    const double time = elapsed_seconds(start);
+    const auto evaluations = evaluator.get_evaluations();
+    const auto batches = std::max<std::uint64_t>(evaluator.get_batches(), 1);
+
+    std::cout << board_size << "x" << board_size << " " << name << " with "
+                  << std::setw(2) << threads << " threads: "
+                  << static_cast<long long>(positions.load() / time) << " evals/sec, "
+                  << std::fixed << std::setprecision(2)
+                  << static_cast<double>(evaluations) / batches << " per batch";
+
+    const auto cache = evaluator.get_cache();
+    if (cache) {
+        std::cout << ", " << 100.0 * cache->get_hits() / std::max<std::uint64_t>(cache->get_probes(), 1)
+                      << "% cache hits";
+    }
+    std::cout << std::endl;
+}
+
+void benchmark_evaluator(double seconds) {
+    const int board_size = std::min(19, Board::BOARD_SIZE);
+
+    {
+        auto backend = std::unique_ptr<NetworkBackend>(new StubBackend(1000));
+        BatchEvaluator evaluator(std::move(backend), 16, 500);
+        for (int threads : {1, 4, 16}) {
+            run_evaluator(evaluator, board_size, threads, seconds, "stub net");
+        }
+
+        // The random 9x9 openings of 4 moves, which repeat a lot.
+        const int opening_size = std::min(9, Board::BOARD_SIZE);
+        evaluator.set_cache(std::make_shared<EvalCache>());
+        run_evaluator(evaluator, opening_size, 4, seconds, "stub net, cache", 4);
+        evaluator.get_cache()->set_symmetry(true);
+        run_evaluator(evaluator, opening_size, 4, seconds, "stub net, symmetry cache", 4);
+    }
+    {
+        auto backend = std::unique_ptr<CpuBackend>(new CpuBackend);
+        backend->init_random(32, 4, 0);
+        BatchEvaluator evaluator(std::move(backend), 8, 200);
+        run_evaluator(evaluator, board_size, 1, seconds, "cpu net 32x4");
+    }
+}
+
+void benchmark_network(double seconds) {
+    const int batch_size = 8;
+    const int shapes[][2] = {{32, 4}, {64, 6}, {128, 10}};
+
+    for (int board_size : {9, 19}) {
+        if (board_size > Board::BOARD_SIZE) {
+            continue;
+        }
+        GameState state;
+        state.clear_board(board_size, 7.5f);
+
+        const int input_size = Features::get_input_size(board_size);
+        std::vector<float> inputs(batch_size * input_size);
+        for (int b = 0; b < batch_size; ++b) {
+            Features::encode(state.board, inputs.data() + b * input_size);
+            state.play_random_move(state.get_tomove());
+        }
+        std::vector<NetResult> results(batch_size);
+
+        for (const auto &shape : shapes) {
+            CpuBackend backend;
+            backend.init_random(shape[0], shape[1], 0);
+
+            long long evaluations = 0;
+            const auto start = Clock::now();
+            do {
+                backend.forward(board_size, batch_size, inputs.data(), results.data());
+                evaluations += batch_size;
+            } while (elapsed_seconds(start) < seconds);
+            const double time = elapsed_seconds(start);
+
+            std::cout << board_size << "x" << board_size << " " << backend.get_name() << " net "
+                          << std::setw(3) << shape[0] << " filters "
+                          << std::setw(2) << shape[1] << " blocks: "
+                          << std::fixed << std::setprecision(1)
+                          << evaluations / time << " evals/sec"
+                          << std::endl;
+        }
+    }
+}
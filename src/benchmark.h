@@ -0,0 +1,66 @@
+#ifndef BENCHMARK_H_INCLUDE
+#define BENCHMARK_H_INCLUDE
+
+#include <cstdint>
+#include <string>
+
+#include "board.h"
+
+// Run all benchmarks and print the results.
+void benchmark_all();
+
+// Run one suite by the name, "all", "board", "perft", "playouts",
+// "ladders", "search", "gtp", "evaluator" or "network". Return false if
+// the name is unknown.
+bool benchmark_suite(const std::string &name);
+
+// Count the leaves of the legal move tree of the board to the depth,
+// like perft of chess. The moves are the legal moves of Board::
+// legal_moves(), without pass, and the positional superko is not
+// checked. The board is the same after the call.
+std::uint64_t perft(Board &board, int depth);
+
+// Run perft from 1 to the depth on the fixed positions, print the
+// counts and the leaves per second, and compare them with the known
+// counts. Each position stops at its own deepest depth. Return false if
+// any count is wrong.
+bool benchmark_perft(int depth);
+
+// Measure the board hot paths on 9x9, 13x13 and 19x19 with recorded
+// random games: play_move_assume_legal(), undo_move(), legal_move(), the
+// capture heavy end of the games, final_score(), compute_hash() and
+// random playouts. Each measure runs for the given seconds.
+void benchmark_board(double seconds);
+
+// Measure the random playouts per second from the empty board on 9x9
+// and 19x19. Each board size runs for the given seconds.
+void benchmark_playouts(double seconds);
+
+// Measure the search playouts per second on the 19x19 empty board with
+// 1, 2, 4, 8 and 16 threads. Each thread count runs for the given
+// seconds.
+void benchmark_search_scaling(double seconds);
+
+// Measure the GTP commands per second by replaying play and undo
+// commands of a random 19x19 game for the given seconds.
+void benchmark_gtp(double seconds);
+
+// Measure the network evaluations per second and the mean batch size of
+// the batch evaluator, with the stub backend of 1 ms latency and 1 to 16
+// client threads, then with the evaluation cache on the short random 9x9
+// openings, then with the random CPU network. The evaluations include
+// the cache hits. Each setting runs
+// for the given seconds.
+void benchmark_evaluator(double seconds);
+
+// Measure the evaluations per second of the CPU network with random
+// weights, for several filters and blocks on 9x9 and 19x19, with the
+// batch size 8. Each network runs for the given seconds.
+void benchmark_network(double seconds);
+
+// Measure the ladder reads per second of the strings with one or two
+// liberties, and the time of Ladder::encode(), on the positions of
+// random 9x9 and 19x19 games. Each board size runs for the given seconds.
+void benchmark_ladders(double seconds);
+
+#endif
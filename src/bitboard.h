@@ -0,0 +1,154 @@
+#ifndef BITBOARD_H_INCLUDE
+#define BITBOARD_H_INCLUDE
+
+#include <array>
+#include <cstdint>
+
+// The fixed size bit set over the board vertices. The words are padded
+// to a multiple of 256 bits so that the loops below could be compiled
+// into whole SIMD registers (e.g., -O3 -mavx2).
+template<int NUM_BITS>
+class Bitboard {
+public:
+    static constexpr int NUM_WORDS = ((NUM_BITS + 255) / 256) * 4;
+
+    Bitboard() {
+        clear();
+    }
+
+    void clear() {
+        for (int i = 0; i < NUM_WORDS; ++i) m_words[i] = 0ULL;
+    }
+
+    void set(int pos) {
+        m_words[pos >> 6] |= (1ULL << (pos & 63));
+    }
+
+    void reset(int pos) {
+        m_words[pos >> 6] &= ~(1ULL << (pos & 63));
+    }
+
+    bool test(int pos) const {
+        return (m_words[pos >> 6] >> (pos & 63)) & 1ULL;
+    }
+
+    // Return the number of set bits.
+    int count() const {
+        int cnt = 0;
+        for (int i = 0; i < NUM_WORDS; ++i) cnt += popcount(m_words[i]);
+        return cnt;
+    }
+
+    bool empty() const {
+        std::uint64_t any = 0ULL;
+        for (int i = 0; i < NUM_WORDS; ++i) any |= m_words[i];
+        return any == 0ULL;
+    }
+
+    // Return the lowest set position, or -1 if it is empty.
+    int first() const {
+        for (int i = 0; i < NUM_WORDS; ++i) {
+            if (m_words[i]) return (i << 6) + ctz(m_words[i]);
+        }
+        return -1;
+    }
+
+    // Move every bit to the higher position by n (0 < n < 64).
+    Bitboard shift_up(int n) const {
+        Bitboard out;
+        out.m_words[0] = m_words[0] << n;
+        for (int i = 1; i < NUM_WORDS; ++i) {
+            out.m_words[i] = (m_words[i] << n) | (m_words[i-1] >> (64 - n));
+        }
+        return out;
+    }
+
+    // Move every bit to the lower position by n (0 < n < 64).
+    Bitboard shift_down(int n) const {
+        Bitboard out;
+        for (int i = 0; i < NUM_WORDS-1; ++i) {
+            out.m_words[i] = (m_words[i] >> n) | (m_words[i+1] << (64 - n));
+        }
+        out.m_words[NUM_WORDS-1] = m_words[NUM_WORDS-1] >> n;
+        return out;
+    }
+
+    // Return the bits plus their four neighbors. The row width is
+    // x_shift. The bits outside the board should be masked by the
+    // caller.
+    Bitboard dilate(int x_shift) const {
+        return *this | shift_up(1) | shift_down(1) |
+                   shift_up(x_shift) | shift_down(x_shift);
+    }
+
+    Bitboard operator|(const Bitboard &other) const {
+        Bitboard out;
+        for (int i = 0; i < NUM_WORDS; ++i) out.m_words[i] = m_words[i] | other.m_words[i];
+        return out;
+    }
+
+    Bitboard operator&(const Bitboard &other) const {
+        Bitboard out;
+        for (int i = 0; i < NUM_WORDS; ++i) out.m_words[i] = m_words[i] & other.m_words[i];
+        return out;
+    }
+
+    Bitboard operator^(const Bitboard &other) const {
+        Bitboard out;
+        for (int i = 0; i < NUM_WORDS; ++i) out.m_words[i] = m_words[i] ^ other.m_words[i];
+        return out;
+    }
+
+    // Return the bits which are set here but not in the other.
+    Bitboard operator-(const Bitboard &other) const {
+        Bitboard out;
+        for (int i = 0; i < NUM_WORDS; ++i) out.m_words[i] = m_words[i] & ~other.m_words[i];
+        return out;
+    }
+
+    Bitboard &operator|=(const Bitboard &other) {
+        for (int i = 0; i < NUM_WORDS; ++i) m_words[i] |= other.m_words[i];
+        return *this;
+    }
+
+    Bitboard &operator&=(const Bitboard &other) {
+        for (int i = 0; i < NUM_WORDS; ++i) m_words[i] &= other.m_words[i];
+        return *this;
+    }
+
+    bool operator==(const Bitboard &other) const {
+        std::uint64_t diff = 0ULL;
+        for (int i = 0; i < NUM_WORDS; ++i) diff |= m_words[i] ^ other.m_words[i];
+        return diff == 0ULL;
+    }
+
+    bool operator!=(const Bitboard &other) const {
+        return !(*this == other);
+    }
+
+private:
+    static int popcount(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(x);
+#else
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return (x * 0x0101010101010101ULL) >> 56;
+#endif
+    }
+
+    static int ctz(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(x);
+#else
+        int n = 0;
+        while (!(x & 1ULL)) { x >>= 1; ++n; }
+        return n;
+#endif
+    }
+
+    std::array<std::uint64_t, NUM_WORDS> m_words;
+};
+
+#endif
@@ -1,9 +1,12 @@
 #include <string>
 #include <sstream>
-#include <queue>
-#include <functional>
+#include <algorithm>
 
 #include "board.h"
+#include "zobrist.h"
+#include "random.h"
+#include "pattern.h"
+#include "perf_counters.h"
 
 constexpr int Board::BOARD_SIZE;
 constexpr int Board::NUM_VERTICES;
@@ -13,35 +16,116 @@ constexpr int Board::PASS;
 constexpr int Board::RESIGN;
 constexpr int Board::NULL_VERTEX;
 
-void Board::reset_board(int board_size) {
-    m_board_size = std::min(board_size, BOARD_SIZE);
+// Widen the packed weights of both colors to the packed sums.
+static std::uint64_t widen_weights(std::uint32_t weights) {
+    return (weights & 0xffff) | (static_cast<std::uint64_t>(weights >> 16) << 32);
+}
+
+// Get the weight of the color from the packed sums.
+static int get_packed_sum(std::uint64_t sums, int color) {
+    return static_cast<std::uint32_t>(sums >> (32 * color));
+}
 
-    const int x_shift = m_board_size+2;
-    m_directions[0] = (-x_shift);
-    m_directions[1] = (-1);
-    m_directions[2] = (+1);
-    m_directions[3] = (+x_shift);
+Board::Board(const Board &other) {
+    *this = other;
+}
+
+Board &Board::operator=(const Board &other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    copy_position(other);
+    m_journal = other.m_journal;
+    m_undo_entries = other.m_undo_entries;
+    m_undo_merges = other.m_undo_merges;
+    m_undo_strings = other.m_undo_strings;
+    m_undo_stones = other.m_undo_stones;
+    return *this;
+}
 
-    for (int vtx = 0; vtx < NUM_VERTICES + 1; ++vtx) {
+void Board::copy_position(const Board &other) {
+    // Copy only the vertices of the board size.
+    const int num_vertices = other.m_num_vertices;
+    std::copy_n(std::begin(other.m_state), num_vertices, std::begin(m_state));
+    std::copy_n(std::begin(other.m_next), num_vertices, std::begin(m_next));
+    std::copy_n(std::begin(other.m_parent), num_vertices, std::begin(m_parent));
+    std::copy_n(std::begin(other.m_libs), num_vertices, std::begin(m_libs));
+    std::copy_n(std::begin(other.m_lib_sums), num_vertices, std::begin(m_lib_sums));
+    std::copy_n(std::begin(other.m_lib_square_sums), num_vertices, std::begin(m_lib_square_sums));
+    std::copy_n(std::begin(other.m_stones), num_vertices, std::begin(m_stones));
+    std::copy_n(std::begin(other.m_patterns), num_vertices, std::begin(m_patterns));
+    std::copy_n(std::begin(other.m_weights), num_vertices, std::begin(m_weights));
+    std::copy_n(std::begin(other.m_row_weights), other.m_shift, std::begin(m_row_weights));
+    std::copy_n(std::begin(other.m_empty), other.m_empty_cnt, std::begin(m_empty));
+    std::copy_n(std::begin(other.m_empty_idx), num_vertices, std::begin(m_empty_idx));
+    m_bitboards = other.m_bitboards;
+    m_offsets = other.m_offsets;
+
+    m_total_weights = other.m_total_weights;
+    m_pattern_weights = other.m_pattern_weights;
+    m_empty_cnt = other.m_empty_cnt;
+    m_board_size = other.m_board_size;
+    m_shift = other.m_shift;
+    m_num_vertices = other.m_num_vertices;
+    m_last_move = other.m_last_move;
+    m_tomove = other.m_tomove;
+    m_komove = other.m_komove;
+    m_passes = other.m_passes;
+    m_hash = other.m_hash;
+    m_ko_hash = other.m_ko_hash;
+
+    clear_undo();
+}
+
+void Board::reset_board(int board_size) {
+    m_board_size = std::min(board_size, BOARD_SIZE);
+    m_shift = m_board_size + 2;
+    m_num_vertices = m_shift * m_shift;
+    m_offsets = {-m_shift, -1, +1, +m_shift,
+                 -m_shift-1, -m_shift+1, m_shift-1, m_shift+1};
+
+    // Only the vertices of this board size are used, the rest of the
+    // arrays is never read.
+    for (int vtx = 0; vtx < m_num_vertices; ++vtx) {
         m_parent[vtx] = NUM_VERTICES;
         m_next[vtx] = NUM_VERTICES;
         m_stones[vtx] = 0;
-        m_liberties[vtx] = 0;
-        if (vtx != NUM_VERTICES)
-            m_state[vtx] = INVLD;
+        m_libs[vtx] = 0;
+        m_lib_sums[vtx] = 0;
+        m_lib_square_sums[vtx] = 0;
+        m_state[vtx] = INVLD;
     }
-    m_liberties[NUM_VERTICES] = 16384;
 
+    for (auto &bb : m_bitboards) {
+        bb.clear();
+    }
+
+    m_empty_cnt = 0;
     for (int y = 0; y < m_board_size; ++y) {
         for (int x = 0; x < m_board_size; ++x) {
-            m_state[get_vertex(x,y)] = EMPTY;
+            const int vtx = get_vertex(x,y);
+            m_state[vtx] = EMPTY;
+            m_bitboards[EMPTY].set(vtx);
+            m_empty_idx[vtx] = m_empty_cnt;
+            m_empty[m_empty_cnt++] = vtx;
         }
     }
 
+    m_tomove = BLACK;
+    m_last_move = NULL_VERTEX;
+    m_komove = NULL_VERTEX;
     m_passes = 0;
+
+    m_ko_hash = compute_ko_hash();
+    update_hash();
+    reset_patterns();
+
+    clear_undo();
 }
 
 bool Board::legal_move(int vtx, int color) const {
+    PERF_COUNT(LEGAL_CHECKS);
     if (vtx == PASS || vtx == RESIGN) {
         return true;
     }
@@ -61,18 +145,166 @@ bool Board::legal_move(int vtx, int color) const {
     return true;
 }
 
+void Board::legal_moves(int color, std::vector<int> &moves) const {
+    PERF_ADD(LEGAL_CHECKS, m_empty_cnt);
+    moves.clear();
+    for (int i = 0; i < m_empty_cnt; ++i) {
+        const int vtx = m_empty[i];
+        if (vtx != m_komove && !is_suicide(vtx, color)) {
+            moves.emplace_back(vtx);
+        }
+    }
+}
+
+std::vector<int> Board::legal_moves(int color) const {
+    auto moves = std::vector<int>{};
+    moves.reserve(m_empty_cnt);
+    legal_moves(color, moves);
+    return moves;
+}
+
+int Board::random_move(int color, Random &rng) const {
+    if (m_empty_cnt == 0) {
+        return PASS;
+    }
+
+    // Scan the empty list from a random start. It is a bit biased but
+    // much cheaper than collecting all legal moves.
+    const int start = rng.randfix(m_empty_cnt);
+    for (int i = 0; i < m_empty_cnt; ++i) {
+        int idx = start + i;
+        if (idx >= m_empty_cnt) {
+            idx -= m_empty_cnt;
+        }
+        const int vtx = m_empty[idx];
+
+        if (vtx != m_komove &&
+                !is_eyeshape(vtx, color) &&
+                !is_suicide(vtx, color)) {
+            return vtx;
+        }
+    }
+    return PASS;
+}
+
+int Board::pattern_move(int color, Random &rng) const {
+    // The urgent moves around the last move.
+    int urgent[5];
+    int urgent_cnt = 0;
+    if (m_last_move >= 0 && m_last_move < NUM_VERTICES &&
+            m_state[m_last_move] == !color) {
+        // Capture the last move.
+        const int lib = get_atari_liberty(m_last_move);
+        if (lib != NULL_VERTEX && lib != m_komove) {
+            urgent[urgent_cnt++] = lib;
+        }
+
+        // Save our string in atari if the move gives it more liberties.
+        for (int k = 0; k < 4; ++k) {
+            const int avtx = m_last_move + m_offsets[k];
+            if (m_state[avtx] != color) {
+                continue;
+            }
+            const int escape = get_atari_liberty(avtx);
+            if (escape == NULL_VERTEX || escape == m_komove) {
+                continue;
+            }
+            int empty_cnt = 0;
+            for (int j = 0; j < 4; ++j) {
+                empty_cnt += m_state[escape + m_offsets[j]] == EMPTY;
+            }
+            if (empty_cnt >= 2) {
+                urgent[urgent_cnt++] = escape;
+            }
+        }
+    }
+    while (urgent_cnt > 0) {
+        const int i = rng.randfix(urgent_cnt);
+        const int vtx = urgent[i];
+        if (Pattern::get_weight(m_patterns[vtx], color) > 0 && !is_suicide(vtx, color)) {
+            return vtx;
+        }
+        urgent[i] = urgent[--urgent_cnt];
+    }
+
+    // The good shapes next to the last move.
+    if (m_last_move >= 0 && m_last_move < NUM_VERTICES) {
+        int shapes[Pattern::NUM_NEIGHBORS];
+        int shape_cnt = 0;
+        for (int k = 0; k < Pattern::NUM_NEIGHBORS; ++k) {
+            const int vtx = m_last_move + m_offsets[k];
+            if (m_state[vtx] == EMPTY &&
+                    Pattern::get_weight(m_patterns[vtx], color) >= Pattern::SHAPE_WEIGHT &&
+                    is_playout_move(vtx, color)) {
+                shapes[shape_cnt++] = vtx;
+            }
+        }
+        if (shape_cnt > 0) {
+            return shapes[rng.randfix(shape_cnt)];
+        }
+    }
+
+    if (!m_pattern_weights) {
+        return random_move(color, rng);
+    }
+
+    // Pick the row, then the point in the row. Only our eyes are left if
+    // the total is zero.
+    const int total = get_packed_sum(m_total_weights, color);
+    if (total == 0) {
+        return PASS;
+    }
+    const int shift = 16 * color;
+    for (int tries = 0; tries < 8; ++tries) {
+        int r = rng.randfix(total);
+        int row = 1;
+        while (r >= get_packed_sum(m_row_weights[row], color)) {
+            r -= get_packed_sum(m_row_weights[row++], color);
+        }
+        int vtx = row * m_shift + 1;
+        while (r >= static_cast<int>((m_weights[vtx] >> shift) & 0xffff)) {
+            r -= (m_weights[vtx++] >> shift) & 0xffff;
+        }
+        if (is_playout_move(vtx, color)) {
+            return vtx;
+        }
+    }
+    return random_move(color, rng);
+}
+
+bool Board::is_eyeshape(int vtx, int color) const {
+    for (int k = 0; k < 4; ++k) {
+        const int state = m_state[vtx + m_offsets[k]];
+        if (state != color && state != INVLD) {
+            return false;
+        }
+    }
+
+    int diagonal_cnt[4] = {0, 0, 0, 0};
+    for (int k = 0; k < 4; ++k) {
+        diagonal_cnt[m_state[vtx + m_offsets[4+k]]]++;
+    }
+
+    // The eye on the edge could not afford any opponent diagonal. The
+    // one in the center could afford one.
+    const int opp_diagonals = diagonal_cnt[!color];
+    if (diagonal_cnt[INVLD] > 0) {
+        return opp_diagonals == 0;
+    }
+    return opp_diagonals <= 1;
+}
+
 bool Board::is_suicide(int vtx, int color) const {
     for (auto k = 0; k < 4; ++k) {
-        const int avtx = vtx + m_directions[k];
-        const int libs =  m_liberties[m_parent[avtx]];
+        const int avtx = vtx + m_offsets[k];
         const int state = m_state[avtx];
 
         if (state == EMPTY) {
             return false;
-        } else if (state == color && libs > 1) {
+        } else if (state == color && !is_only_liberty(m_parent[avtx], vtx)) {
             // Be sure that the string at least is one liberty.
             return false;
-        } else if (state == (!color) && libs <= 1) {
+        } else if (state == (!color) && is_only_liberty(m_parent[avtx], vtx)) {
             // We can capture opponent's stone.
             return false;
         }
@@ -81,7 +313,83 @@ bool Board::is_suicide(int vtx, int color) const {
     return true;
 }
 
+bool Board::is_self_atari(int vtx, int color) const {
+    int empty_cnt = 0;
+    for (int k = 0; k < 4; ++k) {
+        empty_cnt += m_state[vtx + m_offsets[k]] == EMPTY;
+    }
+    if (empty_cnt >= 2) {
+        // The cheap case, it keeps two liberties.
+        return false;
+    }
+
+    // Sum the pseudo liberties of the new string. The point itself is
+    // counted once for every neighbor of ours, so take it out.
+    std::uint64_t libs = 0;
+    std::uint64_t lib_sum = 0;
+    std::uint64_t lib_square_sum = 0;
+    int pars[4];
+    int par_cnt = 0;
+    int stones = 1;
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + m_offsets[k];
+        const int ip = m_parent[avtx];
+        const int state = m_state[avtx];
+
+        if (state == EMPTY) {
+            libs += 1;
+            lib_sum += avtx;
+            lib_square_sum += avtx * avtx;
+        } else if (state == color) {
+            libs -= 1;
+            lib_sum -= vtx;
+            lib_square_sum -= vtx * vtx;
+            if (std::find(pars, pars + par_cnt, ip) == pars + par_cnt) {
+                pars[par_cnt++] = ip;
+                libs += m_libs[ip];
+                lib_sum += m_lib_sums[ip];
+                lib_square_sum += m_lib_square_sums[ip];
+                stones += m_stones[ip];
+            }
+        } else if (state == !color && is_only_liberty(ip, vtx)) {
+            return false;
+        }
+    }
+
+    return stones >= 2 && libs * lib_square_sum == lib_sum * lib_sum;
+}
+
+bool Board::is_atari_parent(int ip) const {
+    const std::uint64_t libs = m_libs[ip];
+    const std::uint64_t lib_sum = m_lib_sums[ip];
+    return libs > 0 && libs * m_lib_square_sums[ip] == lib_sum * lib_sum;
+}
+
+bool Board::is_only_liberty(int ip, int vtx) const {
+    const std::uint32_t libs = m_libs[ip];
+    return m_lib_sums[ip] == libs * vtx &&
+               m_lib_square_sums[ip] == libs * vtx * vtx;
+}
+
+bool Board::is_playout_move(int vtx, int color) const {
+    return vtx != m_komove &&
+               !is_suicide(vtx, color) &&
+               !is_self_atari(vtx, color);
+}
+
 void Board::play_move_assume_legal(int vtx, int color) {
+    PERF_COUNT(MOVES_PLAYED);
+    UndoEntry entry;
+    entry.vtx = vtx;
+    entry.last_move = m_last_move;
+    entry.komove = m_komove;
+    entry.passes = m_passes;
+    entry.color = color;
+    entry.tomove = m_tomove;
+    entry.merges = 0;
+    entry.removed = 0;
+    entry.suicided = false;
+
     m_tomove = color;
 
     if (vtx == PASS) {
@@ -89,43 +397,122 @@ void Board::play_move_assume_legal(int vtx, int color) {
         m_komove = NULL_VERTEX;
     } else {
         m_passes = 0;
-        m_komove = update_board(vtx, m_tomove);
+        m_komove = update_board(vtx, m_tomove, entry);
+    }
+    if (m_journal) {
+        m_undo_entries.emplace_back(entry);
     }
 
     m_last_move = vtx;
-    m_tomove = !m_tomove ;
+    m_tomove = !m_tomove;
+    update_hash();
+}
+
+bool Board::undo_move() {
+    if (m_undo_entries.empty()) {
+        return false;
+    }
+
+    const auto entry = m_undo_entries.back();
+    m_undo_entries.pop_back();
+
+    const int vtx = entry.vtx;
+    const int color = entry.color;
+
+    if (vtx != PASS) {
+        // Play the journal backward, the suicide, the merges, then the
+        // captures.
+        int captured = entry.removed;
+        if (entry.suicided) {
+            restore_string(color);
+            captured--;
+        }
+        for (int i = 0; i < entry.merges; ++i) {
+            split_string();
+        }
+        for (int i = 0; i < captured; ++i) {
+            restore_string(!color);
+        }
+        remove_stone(vtx, color);
+        m_parent[vtx] = NUM_VERTICES;
+    }
+
+    m_last_move = entry.last_move;
+    m_komove = entry.komove;
+    m_passes = entry.passes;
+    m_tomove = entry.tomove;
+    update_hash();
+
+    return true;
+}
+
+int Board::get_undo_size() const {
+    return m_undo_entries.size();
 }
 
-int Board::update_board(int vtx, int color) {
+void Board::clear_undo() {
+    m_undo_entries.clear();
+    m_undo_merges.clear();
+    m_undo_strings.clear();
+    m_undo_stones.clear();
+}
+
+void Board::set_journal(bool enabled) {
+    if (!enabled) {
+        clear_undo();
+    }
+    m_journal = enabled;
+}
+
+int Board::update_board(int vtx, int color, UndoEntry &entry) {
     add_stone(vtx, color);
 
     int captured_stones = 0;
     int captured_vtx = NULL_VERTEX;
     bool is_eyeplay = true;
 
+    // All captures go first, then all merges, so undo could play them
+    // backward in two groups.
     for (int k = 0; k < 4; ++k) {
-        const int avtx = vtx + m_directions[k];
+        const int avtx = vtx + m_offsets[k];
         const int aip = m_parent[avtx];
-        const int state = m_state[avtx];
 
-        if (state == !color) {
-            if (m_liberties[aip] <= 0) {
-                const int this_captured = remove_string(avtx);
-                captured_vtx = avtx;
-                captured_stones += this_captured;
-            }
-        } else if (state == color) {
-            const int ip = m_parent[vtx];
-            if (ip != aip) {
-                merge_strings(ip, aip);
+        if (m_state[avtx] == !color && m_libs[aip] == 0) {
+            const int this_captured = remove_string(aip);
+            captured_vtx = avtx;
+            captured_stones += this_captured;
+            entry.removed++;
+            PERF_ADD(CAPTURES, this_captured);
+        }
+    }
+
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + m_offsets[k];
+        if (m_state[avtx] != color) {
+            continue;
+        }
+        is_eyeplay = false;
+
+        const int ip = m_parent[vtx];
+        const int aip = m_parent[avtx];
+        if (ip != aip) {
+            const int absorbed = merge_strings(ip, aip);
+            if (m_journal) {
+                m_undo_merges.push_back({
+                    m_parent[absorbed], static_cast<std::uint16_t>(absorbed),
+                    m_stones[absorbed], m_libs[absorbed],
+                    m_lib_sums[absorbed], m_lib_square_sums[absorbed]});
             }
-            is_eyeplay = false;
+            entry.merges++;
+            PERF_COUNT(MERGES);
         }
     }
 
-    if (m_liberties[m_parent[vtx]] == 0) {
+    if (m_libs[m_parent[vtx]] == 0) {
         // Suicide move, this move is illegal in general rule.
-        const int sucide_stones = remove_string(vtx);
+        remove_string(m_parent[vtx]);
+        entry.removed++;
+        entry.suicided = true;
     }
 
     if (captured_stones == 1 && is_eyeplay) {
@@ -136,36 +523,50 @@ int Board::update_board(int vtx, int color) {
     return NULL_VERTEX;
 }
 
-void Board::merge_strings(int ip, int aip) {
+int Board::merge_strings(int ip, int aip) {
     if (m_stones[ip] < m_stones[aip]) {
         std::swap(aip, ip);
     }
     m_stones[ip] += m_stones[aip];
-    int next_pos = aip;
+    m_libs[ip] += m_libs[aip];
+    m_lib_sums[ip] += m_lib_sums[aip];
+    m_lib_square_sums[ip] += m_lib_square_sums[aip];
 
+    int next_pos = aip;
     do {
-        for (int k = 0; k < 4; k++) {
-            const int apos = next_pos + m_directions[k];
-            if (m_state[apos] == EMPTY) {
-                bool found = false;
-                for (int kk = 0; kk < 4; kk++) {
-                    const int aapos = apos + m_directions[kk];
-                    if (m_parent[aapos] == ip) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) {
-                    m_liberties[ip]++;
-                }
-            }
-        }
-
         m_parent[next_pos] = ip;
         next_pos = m_next[next_pos];
     } while (next_pos != aip);
 
     std::swap(m_next[aip], m_next[ip]);
+    return aip;
+}
+
+void Board::split_string() {
+    const auto merge = m_undo_merges.back();
+    m_undo_merges.pop_back();
+
+    const int ip = merge.parent;
+    const int aip = merge.absorbed;
+
+    // Swapping the next stones again cuts the ring in two.
+    std::swap(m_next[aip], m_next[ip]);
+
+    int next_pos = aip;
+    do {
+        m_parent[next_pos] = aip;
+        next_pos = m_next[next_pos];
+    } while (next_pos != aip);
+
+    m_stones[ip] -= merge.stones;
+    m_libs[ip] -= merge.libs;
+    m_lib_sums[ip] -= merge.lib_sum;
+    m_lib_square_sums[ip] -= merge.lib_square_sum;
+
+    m_stones[aip] = merge.stones;
+    m_libs[aip] = merge.libs;
+    m_lib_sums[aip] = merge.lib_sum;
+    m_lib_square_sums[aip] = merge.lib_square_sum;
 }
 
 int Board::remove_string(int ip) {
@@ -176,115 +577,267 @@ int Board::remove_string(int ip) {
     do {
         remove_stone(pos, color);
         m_parent[pos] = NUM_VERTICES;
+        if (m_journal) {
+            m_undo_stones.emplace_back(pos);
+        }
 
         removed++;
 
         pos = m_next[pos];
     } while (pos != ip);
 
+    if (m_journal) {
+        m_undo_strings.emplace_back(removed);
+    }
     return removed;
 }
 
+void Board::restore_string(int color) {
+    const int size = m_undo_strings.back();
+    const int begin = m_undo_stones.size() - size;
+    const int end = m_undo_stones.size();
+    const int ip = m_undo_stones[begin];
+    m_undo_strings.pop_back();
+
+    for (int i = begin; i < end; ++i) {
+        add_stone(m_undo_stones[i], color);
+    }
+
+    // Every stone holds its own pseudo liberties now. Link them in the
+    // old order and sum them into the parent.
+    for (int i = begin; i < end; ++i) {
+        const int pos = m_undo_stones[i];
+        m_next[pos] = i+1 < end ? m_undo_stones[i+1] : ip;
+        if (pos != ip) {
+            m_parent[pos] = ip;
+            m_libs[ip] += m_libs[pos];
+            m_lib_sums[ip] += m_lib_sums[pos];
+            m_lib_square_sums[ip] += m_lib_square_sums[pos];
+        }
+    }
+    m_stones[ip] = size;
+    m_undo_stones.resize(begin);
+}
+
 void Board::add_stone(int vtx, int color) {
     m_next[vtx] = vtx;
     m_parent[vtx] = vtx;
-    m_liberties[vtx] = 0;
+    m_libs[vtx] = 0;
+    m_lib_sums[vtx] = 0;
+    m_lib_square_sums[vtx] = 0;
     m_stones[vtx] = 1;
 
-    int nbr_pars[4];
-    int nbr_par_cnt = 0;
-
     // Set board content.
     m_state[vtx] = static_cast<vertex_t>(color);
-
+    m_ko_hash ^= Zobrist::STATE[EMPTY][vtx];
+    m_ko_hash ^= Zobrist::STATE[color][vtx];
+    m_bitboards[EMPTY].reset(vtx);
+    m_bitboards[color].set(vtx);
+    update_patterns(vtx, EMPTY, color);
+
+    // Remove it from the empty list.
+    const int last = m_empty[--m_empty_cnt];
+    m_empty_idx[last] = m_empty_idx[vtx];
+    m_empty[m_empty_idx[vtx]] = last;
+
+    // Every neighbor stone loses the point once. The others update the
+    // unused parent NUM_VERTICES.
     for (int k = 0; k < 4; ++k) {
-        const auto avtx = vtx + m_directions[k];
+        const auto avtx = vtx + m_offsets[k];
 
         if (m_state[avtx] == EMPTY) {
-            m_liberties[vtx]++;
-        }
-
-
-        bool found = false;
-        const auto ip = m_parent[avtx];
-        for (int i = 0; i < nbr_par_cnt; ++i) {
-            if (nbr_pars[i] == ip) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            m_liberties[ip]--;
-            nbr_pars[nbr_par_cnt++] = ip;
+            m_libs[vtx]++;
+            m_lib_sums[vtx] += avtx;
+            m_lib_square_sums[vtx] += avtx * avtx;
+        } else {
+            const auto ip = m_parent[avtx];
+            m_libs[ip]--;
+            m_lib_sums[ip] -= vtx;
+            m_lib_square_sums[ip] -= vtx * vtx;
         }
     }
 }
 
 void Board::remove_stone(int vtx, int color) {
-    int nbr_pars[4];
-    int nbr_par_cnt = 0;
-
     // Set board content.
     m_state[vtx] = EMPTY;
+    m_ko_hash ^= Zobrist::STATE[color][vtx];
+    m_ko_hash ^= Zobrist::STATE[EMPTY][vtx];
+    m_bitboards[color].reset(vtx);
+    m_bitboards[EMPTY].set(vtx);
+    update_patterns(vtx, color, EMPTY);
 
-    for (int k = 0; k < 4; ++k) {
-        const int avtx = vtx + m_directions[k];
+    // Append it to the empty list.
+    m_empty_idx[vtx] = m_empty_cnt;
+    m_empty[m_empty_cnt++] = vtx;
 
-        bool found = false;
-        const int ip = m_parent[avtx];
-        for (int i = 0; i < nbr_par_cnt; i++) {
-            if (nbr_pars[i] == ip) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            m_liberties[ip]++;
-            nbr_pars[nbr_par_cnt++] = ip;
-        }
+    // Every neighbor stone gains the point once.
+    for (int k = 0; k < 4; ++k) {
+        const int ip = m_parent[vtx + m_offsets[k]];
+        m_libs[ip]++;
+        m_lib_sums[ip] += vtx;
+        m_lib_square_sums[ip] += vtx * vtx;
     }
 }
 
-int Board::compute_reach_color(int color) const {
-    bool marked[NUM_VERTICES];
-    for (int vtx = 0; vtx < NUM_VERTICES; ++vtx) {
-        marked[vtx] = false;
+void Board::update_patterns(int vtx, int old_state, int new_state) {
+    const int diff = old_state ^ new_state;
+
+    // The point is the neighbor k of the point at -m_offsets[k].
+    for (int k = 0; k < Pattern::NUM_NEIGHBORS; ++k) {
+        const int pos = vtx - m_offsets[k];
+        const int code = m_patterns[pos] ^ (diff << (2 * k));
+        m_patterns[pos] = code;
+        if (m_pattern_weights && m_state[pos] == EMPTY) {
+            update_weight(pos, Pattern::WEIGHTS[code]);
+        }
+    }
+    if (m_pattern_weights) {
+        update_weight(vtx, new_state == EMPTY ? Pattern::WEIGHTS[m_patterns[vtx]] : 0);
     }
+}
 
-    int reachable = 0;
-    std::queue<int> open;
+void Board::update_weight(int vtx, std::uint32_t weights) {
+    const auto diff = widen_weights(weights) - widen_weights(m_weights[vtx]);
+    m_weights[vtx] = weights;
+    m_row_weights[vtx / m_shift] += diff;
+    m_total_weights += diff;
+}
 
+void Board::reset_patterns() {
+    std::fill_n(std::begin(m_patterns), m_num_vertices, 0);
     for (int y = 0; y < m_board_size; ++y) {
         for (int x = 0; x < m_board_size; ++x) {
-            const int vtx = get_vertex(x, y);
-            const int state = m_state[vtx];
-
-            if (state == color) {
-                ++reachable;
-                marked[vtx] = true;
-                open.emplace(vtx);
-            } else {
-                marked[vtx] = false;
-            }
+            const int vtx = get_vertex(x,y);
+            m_patterns[vtx] = compute_pattern(vtx);
         }
     }
-    while (!open.empty()) {
-        const int vtx = open.front();
-        open.pop();
+    m_pattern_weights = false;
+}
 
-        for (int k = 0; k < 4; ++k) {
-            const int neighbor = vtx + m_directions[k];
-            const int state = m_state[neighbor];
+void Board::reset_weights() {
+    std::fill_n(std::begin(m_weights), m_num_vertices, 0);
+    std::fill_n(std::begin(m_row_weights), m_shift, 0);
+    m_total_weights = 0;
 
-            if (!marked[neighbor] && state == color) {
-                ++reachable;
-                marked[neighbor] = true;
-                open.emplace(neighbor);
-            }
+    for (int i = 0; i < m_empty_cnt; ++i) {
+        const int vtx = m_empty[i];
+        update_weight(vtx, Pattern::WEIGHTS[m_patterns[vtx]]);
+    }
+}
+
+void Board::set_pattern_weights(bool enabled) {
+    if (enabled && !m_pattern_weights) {
+        reset_weights();
+    }
+    m_pattern_weights = enabled;
+}
+
+std::uint16_t Board::get_pattern(int vtx) const {
+    return m_patterns[vtx];
+}
+
+std::uint16_t Board::compute_pattern(int vtx) const {
+    int code = 0;
+    for (int k = 0; k < Pattern::NUM_NEIGHBORS; ++k) {
+        code |= m_state[vtx + m_offsets[k]] << (2 * k);
+    }
+    return code;
+}
+
+int Board::get_atari_bits(int vtx) const {
+    int bits = 0;
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + m_offsets[k];
+        const int state = m_state[avtx];
+        if ((state == BLACK || state == WHITE) && is_atari_parent(m_parent[avtx])) {
+            bits |= 1 << k;
         }
     }
+    return bits;
+}
+
+int Board::get_total_weight(int color) const {
+    return get_packed_sum(m_total_weights, color);
+}
+
+int Board::compute_reach_color(int color) const {
+    // The stones and the empty points connected to them.
+    const auto reach = flood_fill(m_bitboards[color],
+                                      m_bitboards[color] | m_bitboards[EMPTY]);
+    return reach.count();
+}
+
+int Board::get_liberties(int vtx) const {
+    const int ip = m_parent[vtx];
+    if (m_libs[ip] <= 1) {
+        return m_libs[ip];
+    }
+    if (is_atari_parent(ip)) {
+        return 1;
+    }
+    return get_liberty_set(vtx).count();
+}
+
+Board::bitboard_t Board::get_liberty_set(int vtx) const {
+    return get_liberties_bitboard(get_string_bitboard(vtx));
+}
+
+void Board::get_liberty_list(int vtx, std::vector<int> &liberties) const {
+    liberties.clear();
+
+    auto libs = get_liberty_set(vtx);
+    for (int pos = libs.first(); pos >= 0; pos = libs.first()) {
+        liberties.emplace_back(pos);
+        libs.reset(pos);
+    }
+}
+
+int Board::get_string_size(int vtx) const {
+    return m_stones[m_parent[vtx]];
+}
+
+bool Board::is_atari(int vtx) const {
+    return is_atari_parent(m_parent[vtx]);
+}
+
+int Board::get_atari_liberty(int vtx) const {
+    const int ip = m_parent[vtx];
+    if (!is_atari_parent(ip)) {
+        return NULL_VERTEX;
+    }
+    return m_lib_sums[ip] / m_libs[ip];
+}
+
+const Board::bitboard_t &Board::get_bitboard(int state) const {
+    return m_bitboards[state];
+}
+
+Board::bitboard_t Board::get_string_bitboard(int vtx) const {
+    bitboard_t stones;
+    int pos = vtx;
+    do {
+        stones.set(pos);
+        pos = m_next[pos];
+    } while (pos != vtx);
+
+    return stones;
+}
 
-    return reachable;
+Board::bitboard_t Board::get_liberties_bitboard(const bitboard_t &stones) const {
+    return stones.dilate(m_shift) & m_bitboards[EMPTY];
+}
+
+Board::bitboard_t Board::flood_fill(const bitboard_t &seed, const bitboard_t &mask) const {
+    auto region = seed;
+    while (true) {
+        const auto next = (region.dilate(m_shift) & mask) | seed;
+        if (next == region) {
+            break;
+        }
+        region = next;
+    }
+    return region;
 }
 
 std::string Board::to_string() const {
@@ -316,6 +869,22 @@ std::string Board::to_string() const {
     return ss.str();
 }
 
+std::string Board::vertex_to_text(int vtx) const {
+    if (vtx == PASS) {
+        return "pass";
+    } else if (vtx == RESIGN) {
+        return "resign";
+    } else if (vtx == NULL_VERTEX) {
+        return "null";
+    }
+
+    const char *x_lable_map = "ABCDEFGHJKLMNOPQRST";
+    std::string out;
+    out += x_lable_map[get_x(vtx)];
+    out += std::to_string(get_y(vtx)+1);
+    return out;
+}
+
 int Board::get_tomove() const {
     return m_tomove;
 }
@@ -336,21 +905,94 @@ int Board::get_passes() const {
     return m_passes;
 }
 
+int Board::get_empty_count() const {
+    return m_empty_cnt;
+}
+
+int Board::get_empty(int idx) const {
+    return m_empty[idx];
+}
+
 int Board::get_state(int vtx) const {
     return m_state[vtx];
 }
 
+std::uint64_t Board::get_hash() const {
+    return m_hash;
+}
+
+std::uint64_t Board::get_ko_hash() const {
+    return m_ko_hash;
+}
+
 std::uint64_t Board::compute_hash() const {
-    // TODO: Use Zobrist hash instead of it.
-    char state_map[4] = {'x','o','.', '-'};
-    std::string str;
-    str.resize(NUM_VERTICES, state_map[INVLD]);
+    std::uint64_t hash = compute_ko_hash();
+
+    hash ^= Zobrist::KO_MOVE[m_komove];
+    if (m_tomove == BLACK) {
+        hash ^= Zobrist::BLACK_TO_MOVE;
+    }
+    return hash;
+}
+
+std::uint64_t Board::compute_ko_hash() const {
+    std::uint64_t hash = Zobrist::INIT_SEED;
+
+    for (int vtx = 0; vtx < m_num_vertices; ++vtx) {
+        hash ^= Zobrist::STATE[m_state[vtx]][vtx];
+    }
+    return hash;
+}
+
+std::uint64_t Board::compute_ko_hash_after(int vtx, int color) const {
+    std::uint64_t hash = m_ko_hash;
+    if (vtx == PASS || vtx == RESIGN) {
+        return hash;
+    }
 
-    for (int vtx = 0; vtx < NUM_VERTICES; ++vtx) {
-        str[vtx] = state_map[m_state[vtx]];
+    hash ^= Zobrist::STATE[EMPTY][vtx];
+    hash ^= Zobrist::STATE[color][vtx];
+
+    int nbr_pars[4];
+    int nbr_par_cnt = 0;
+
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + m_offsets[k];
+        const int ip = m_parent[avtx];
+
+        if (m_state[avtx] != !color || !is_only_liberty(ip, vtx)) {
+            continue;
+        }
+
+        bool found = false;
+        for (int i = 0; i < nbr_par_cnt; ++i) {
+            if (nbr_pars[i] == ip) {
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            continue;
+        }
+        nbr_pars[nbr_par_cnt++] = ip;
+
+        // This string will be captured.
+        int pos = ip;
+        do {
+            hash ^= Zobrist::STATE[!color][pos];
+            hash ^= Zobrist::STATE[EMPTY][pos];
+            pos = m_next[pos];
+        } while (pos != ip);
     }
 
-    return std::hash<std::string>{}(str);
+    return hash;
+}
+
+void Board::update_hash() {
+    m_hash = m_ko_hash ^ Zobrist::KO_MOVE[m_komove];
+    if (m_tomove == BLACK) {
+        m_hash ^= Zobrist::BLACK_TO_MOVE;
+    }
 }
 
 int Board::get_index(int x, int y) const {
@@ -358,17 +1000,53 @@ int Board::get_index(int x, int y) const {
 }
 
 int Board::get_vertex(int x, int y) const {
-    return (y+1) * (m_board_size + 2) + (x+1);
+    return (y+1) * m_shift + (x+1);
 }
 
 int Board::get_x(int vtx) const {
-    return vtx % (m_board_size + 2) - 1;
+    return vtx % m_shift - 1;
 }
 
 int Board::get_y(int vtx) const {
-    return vtx / (m_board_size + 2) - 1;
+    return vtx / m_shift - 1;
+}
+
+int Board::get_shift() const {
+    return m_shift;
+}
+
+int Board::get_direction(int k) const {
+    return m_offsets[k];
+}
+
+int Board::get_diagonal(int k) const {
+    return m_offsets[4+k];
 }
 
 void Board::set_to_move(int color) {
     m_tomove = color;
+    update_hash();
+}
+
+void Board::set_stone(int vtx, int color) {
+    add_stone(vtx, color);
+
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + m_offsets[k];
+        const int ip = m_parent[vtx];
+        const int aip = m_parent[avtx];
+
+        if (m_state[avtx] == color && ip != aip) {
+            merge_strings(ip, aip);
+        }
+    }
+    update_hash();
+}
+
+void Board::set_move_state(int tomove, int komove, int last_move, int passes) {
+    m_tomove = tomove;
+    m_komove = komove;
+    m_last_move = last_move;
+    m_passes = passes;
+    update_hash();
 }
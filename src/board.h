@@ -3,13 +3,28 @@
 
 #include <array>
 #include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitboard.h"
+
+// The maximum board size. All arrays of the board are sized by it. A
+// smaller board packs its vertices with its own row width into the front
+// of the arrays, and only that part is cleared and copied.
+#ifndef MAX_BOARD_SIZE
+#define MAX_BOARD_SIZE 19
+#endif
+
+class Random;
 
 class Board {
 public:
-    static constexpr int BOARD_SIZE = 19;
+    static constexpr int BOARD_SIZE = MAX_BOARD_SIZE;
     static constexpr int NUM_VERTICES = (BOARD_SIZE+2) * (BOARD_SIZE+2);
     static constexpr int NUM_INTESECTIONS = BOARD_SIZE * BOARD_SIZE;
 
+    using bitboard_t = Bitboard<NUM_VERTICES>;
+
     static constexpr int PASS = -1;
     static constexpr int RESIGN = -2;
     static constexpr int NULL_VERTEX = NUM_VERTICES+1;
@@ -21,22 +36,150 @@ public:
         INVLD = 3
     };
 
+    Board() = default;
+
+    // Copy only the vertices used by the board size.
+    Board(const Board &other);
+    Board &operator=(const Board &other);
+
+    // Copy the position of the other board without its undo journal.
+    // This board drops its own journal but keeps the storage and the
+    // journal setting, so a scratch board could be reused cheaply.
+    void copy_position(const Board &other);
+
     int get_vertex(int x, int y) const;
 
     int get_index(int x, int y) const;
 
+    // Clear the board. The board size should not be greater than
+    // BOARD_SIZE.
     void reset_board(int board_size);
 
     void play_move_assume_legal(int vtx, int color);
 
+    // Undo the last move played by play_move_assume_legal(). Return
+    // false if there is no move to undo.
+    bool undo_move();
+
+    // Get the number of moves which could be undone.
+    int get_undo_size() const;
+
+    // Drop the undo journal. The moves played before can not be undone
+    // any more.
+    void clear_undo();
+
+    // Turn the undo journal on or off. The moves played without it can
+    // not be undone, but they skip all the journal writes, like the
+    // moves of a playout. Turning it off drops the journal. It is on for
+    // a new board.
+    void set_journal(bool enabled);
+
     bool legal_move(int vtx, int color) const;
 
+    // Collect the legal moves of the color, except pass and resign. It
+    // only visits the empty points.
+    void legal_moves(int color, std::vector<int> &moves) const;
+
+    std::vector<int> legal_moves(int color) const;
+
+    // Select a random legal move which does not fill our own eye. Return
+    // pass if there is no such move.
+    int random_move(int color, Random &rng) const;
+
+    // Select a move in proportion to the 3x3 pattern weights. It is
+    // random_move() if the pattern weights are off. Before
+    // that, capture the last move in atari, save our own string next to
+    // it, or play a good shape next to it. The self-atari of a string is
+    // rejected. Fall back to random_move() if the sampling fails.
+    int pattern_move(int color, Random &rng) const;
+
+    // Return true if the point is our eye. All neighbors are ours and
+    // the diagonals do not make it a false eye.
+    bool is_eyeshape(int vtx, int color) const;
+
+    // Get the 3x3 pattern code of the empty point. See Pattern for the
+    // layout. It is maintained incrementally.
+    std::uint16_t get_pattern(int vtx) const;
+
+    // Compute the 3x3 pattern code from scratch. It should be equal to
+    // get_pattern().
+    std::uint16_t compute_pattern(int vtx) const;
+
+    // Get the atari bits of the point, the bit k is set if the neighbor
+    // at get_direction(k) is a string with only one liberty.
+    int get_atari_bits(int vtx) const;
+
+    // Turn the pattern weights on or off. Only pattern_move() needs them,
+    // so the other boards skip their upkeep. They are off after
+    // reset_board().
+    void set_pattern_weights(bool enabled);
+
+    // Get the sum of the pattern weights of all empty points for the
+    // color. The pattern weights should be on.
+    int get_total_weight(int color) const;
+
+    // Count the stones of the color and the empty points which reach
+    // them, the Tromp-Taylor area of the color. An empty region which
+    // reaches both colors counts for both, so it cancels out in the
+    // difference of the two areas.
     int compute_reach_color(int color) const;
 
+    // The string queries below should be called on a stone vertex.
+
+    // The strings keep only the pseudo-liberty sums, not the liberty
+    // sets. The exact liberties are counted from the stones, so the
+    // three queries below cost O(string size), except get_liberties()
+    // of a string with zero or one liberty. The hot paths should test
+    // is_atari() or get_atari_liberty() instead, they are O(1).
+
+    // Get the number of liberties of the string.
+    int get_liberties(int vtx) const;
+
+    // Get the liberties of the string.
+    bitboard_t get_liberty_set(int vtx) const;
+
+    // Collect the liberties of the string into the list.
+    void get_liberty_list(int vtx, std::vector<int> &liberties) const;
+
+    // Get the number of stones of the string.
+    int get_string_size(int vtx) const;
+
+    // Return true if the string has only one liberty.
+    bool is_atari(int vtx) const;
+
+    // Get the last liberty of the string in atari. Return NULL_VERTEX if
+    // it is not in atari.
+    int get_atari_liberty(int vtx) const;
+
+    // Get the bitboard of all black, white or empty points.
+    const bitboard_t &get_bitboard(int state) const;
+
+    // Get the bitboard of the string which includes the vertex.
+    bitboard_t get_string_bitboard(int vtx) const;
+
+    // Get the empty points next to the stones.
+    bitboard_t get_liberties_bitboard(const bitboard_t &stones) const;
+
+    // Expand the seed through the mask until it stops growing. Return
+    // the reached region, including the seed.
+    bitboard_t flood_fill(const bitboard_t &seed, const bitboard_t &mask) const;
+
     std::string to_string() const;
 
+    // Transfer the vertex to GTP text, like "D4" or "pass".
+    std::string vertex_to_text(int vtx) const;
+
     int get_x(int vtx) const;
     int get_y(int vtx) const;
+
+    // Get the row width of vertex position, the board size + 2.
+    int get_shift() const;
+
+    // Get the offset of the neighbor k, up, left, right and down.
+    int get_direction(int k) const;
+
+    // Get the offset of the diagonal k.
+    int get_diagonal(int k) const;
     int get_state(int vtx) const;
     int get_tomove() const;
     int get_last_move() const;
@@ -44,31 +187,125 @@ public:
     int get_board_size() const;
     int get_passes() const;
 
+    // Get the number of empty points.
+    int get_empty_count() const;
+
+    // Get the empty point by the index of the empty list.
+    int get_empty(int idx) const;
+
     void set_to_move(int color);
 
+    // Put a setup stone on the empty point. It merges the strings but
+    // never captures, so the stones should make a legal position, every
+    // string has a liberty. It can not be undone.
+    void set_stone(int vtx, int color);
+
+    // Set the side to move, ko move, last move and passes of a setup
+    // position.
+    void set_move_state(int tomove, int komove, int last_move, int passes);
+
+    // Get the hash of current board, including the ko move and the side
+    // to move. It is maintained incrementally.
+    std::uint64_t get_hash() const;
+
+    // Get the positional hash, only the stones on the board.
+    std::uint64_t get_ko_hash() const;
+
+    // Compute the hash from scratch. It should be equal to get_hash().
     std::uint64_t compute_hash() const;
 
+    // Compute the positional hash from scratch. It should be equal to
+    // get_ko_hash().
+    std::uint64_t compute_ko_hash() const;
+
+    // Compute the positional hash after playing the move without
+    // playing it. The move should be legal.
+    std::uint64_t compute_ko_hash_after(int vtx, int color) const;
+
 private:
     // Return true if it is suicide move.
     bool is_suicide(int vtx, int color) const;
 
+    // Return true if the move makes a string of two or more stones with
+    // only one liberty and captures nothing.
+    bool is_self_atari(int vtx, int color) const;
+
+    // Return true if the string parent has only one liberty.
+    bool is_atari_parent(int ip) const;
+
+    // Return true if the point is the only liberty of the string parent.
+    bool is_only_liberty(int ip, int vtx) const;
+
+    // Return true if the pattern playouts may play the move.
+    bool is_playout_move(int vtx, int color) const;
+
+    // The undo record of one move. Its merges are stored in
+    // m_undo_merges and its removed strings in m_undo_strings.
+    struct UndoEntry {
+        std::int16_t vtx;
+        std::int16_t last_move;
+        std::int16_t komove;
+        std::int16_t passes;
+        std::uint8_t color;
+        std::uint8_t tomove;
+        std::uint8_t merges;
+        std::uint8_t removed;
+
+        // The last removed string is the played one.
+        bool suicided;
+    };
+
+    // The undo record of one merge. Undo splits the absorbed string off
+    // the parent string, so the strings are never rebuilt by a flood
+    // fill.
+    struct UndoMerge {
+        std::uint16_t parent;
+        std::uint16_t absorbed;
+
+        // The values of the absorbed string before the merge.
+        std::uint16_t stones;
+        std::uint16_t libs;
+        std::uint32_t lib_sum;
+        std::uint32_t lib_square_sum;
+    };
+
     // Update whole board.
-    int update_board(int vtx, int color);
+    int update_board(int vtx, int color, UndoEntry &entry);
+
+    // Merge two same color strings. Return the parent of the absorbed
+    // one, the smaller string.
+    int merge_strings(int ip, int aip);
 
-    // Merge two same color strings.
-    void merge_strings(int ip, int aip);
+    // Split the last merge of the journal.
+    void split_string();
 
-    // Capture a string and remove it.
+    // Capture a string and remove it. The parent should be given, so the
+    // journal stores the stones from the parent in the order of the
+    // string.
     int remove_string(int ip);
 
+    // Put back the last removed string of the journal.
+    void restore_string(int color);
+
     void remove_stone(int vtx, int color);
 
     void add_stone(int vtx, int color);
 
-    // Return true if surround colors are mine.
-    bool is_eyeshape(int vtx, int color);
+    // Merge the ko move and the side to move into the positional hash.
+    void update_hash();
+
+    // Update the pattern codes around the point after its state changed
+    // from the old state to the new state.
+    void update_patterns(int vtx, int old_state, int new_state);
 
-    std::array<int, 4> m_directions;
+    // Update the pattern weights of the point and the sums.
+    void update_weight(int vtx, std::uint32_t weights);
+
+    // Recompute all pattern codes.
+    void reset_patterns();
+
+    // Recompute all pattern weights from the codes.
+    void reset_weights();
 
     // The board state.
     std::array<vertex_t, NUM_VERTICES> m_state;
@@ -79,14 +316,62 @@ private:
     // The parent node of string.
     std::array<std::uint16_t, NUM_VERTICES+1> m_parent;
 
-    // The liberties per string parent.
-    std::array<std::uint16_t, NUM_VERTICES+1> m_liberties;
+    // The pseudo liberties per string parent. An empty point is counted
+    // once for every stone next to it, so the counts are kept by adding
+    // and subtracting, without any set. The string is in atari if all
+    // the counted points are the same one, that is count * square sum
+    // equals sum * sum. The border and the empty points share the parent
+    // NUM_VERTICES, its values are never read.
+    std::array<std::uint16_t, NUM_VERTICES+1> m_libs;
+
+    // The sums of the pseudo liberty vertices per string parent.
+    std::array<std::uint32_t, NUM_VERTICES+1> m_lib_sums;
+
+    // The sums of the squared pseudo liberty vertices per string parent.
+    std::array<std::uint32_t, NUM_VERTICES+1> m_lib_square_sums;
 
     // The stones per string parent.
     std::array<std::uint16_t, NUM_VERTICES+1> m_stones;
 
+    // The bitboards of black stones, white stones and empty points.
+    std::array<bitboard_t, 3> m_bitboards;
+
+    // The 3x3 pattern code per point.
+    std::array<std::uint16_t, NUM_VERTICES> m_patterns;
+
+    // The pattern weights of both colors per point, packed like
+    // Pattern::WEIGHTS. Zero on the stones.
+    std::array<std::uint32_t, NUM_VERTICES> m_weights;
+
+    // The sums of the pattern weights per row, black in the low 32 bits
+    // and white in the high 32 bits. Both sums are never negative, so
+    // adding the packed differences keeps them apart.
+    std::array<std::uint64_t, BOARD_SIZE+2> m_row_weights;
+
+    // The sums of all pattern weights, packed like the row sums.
+    std::uint64_t m_total_weights;
+
+    bool m_pattern_weights;
+
+    // The empty points list.
+    std::array<std::uint16_t, NUM_INTESECTIONS> m_empty;
+
+    // The index of each empty point in the empty list.
+    std::array<std::uint16_t, NUM_VERTICES> m_empty_idx;
+
+    int m_empty_cnt;
+
     int m_board_size;
 
+    // The row width and the number of used vertices of the board size.
+    int m_shift;
+
+    int m_num_vertices;
+
+    // The four directions, up, left, right and down, then the four
+    // diagonals. It is the neighbor order of Pattern.
+    std::array<int, 8> m_offsets;
+
     int m_last_move;
 
     int m_tomove;
@@ -94,6 +379,24 @@ private:
     int m_komove;
 
     int m_passes;
+
+    std::uint64_t m_hash;
+
+    std::uint64_t m_ko_hash;
+
+    bool m_journal{true};
+
+    // The undo journal, one entry per played move.
+    std::vector<UndoEntry> m_undo_entries;
+
+    // The merges of all entries in the journal.
+    std::vector<UndoMerge> m_undo_merges;
+
+    // The sizes of the removed strings of all entries in the journal.
+    std::vector<std::uint16_t> m_undo_strings;
+
+    // The removed stones of all entries in the journal.
+    std::vector<std::uint16_t> m_undo_stones;
 };
 
 #endif
@@ -0,0 +1,558 @@
+#include "cpu_backend.h"
+#include "mapped_file.h"
+#include "random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+constexpr float CpuBackend::BN_EPSILON;
+constexpr char CpuBackend::BINARY_MAGIC[8];
+constexpr int CpuBackend::BINARY_VERSION;
+
+// The GEMM computes the tiles of MR rows and NR columns in registers. The
+// depth is blocked by KC and the columns by NC, so the packed inputs of
+// one block stay in the L2 cache.
+#if defined(__AVX512F__)
+static constexpr int GEMM_MR = 8;
+static constexpr int GEMM_NR = 32;
+#elif defined(__AVX2__) && defined(__FMA__)
+static constexpr int GEMM_MR = 6;
+static constexpr int GEMM_NR = 16;
+#else
+static constexpr int GEMM_MR = 4;
+static constexpr int GEMM_NR = 8;
+#endif
+static constexpr int GEMM_KC = 256;
+static constexpr int GEMM_NC = 512;
+
+static int round_up(int v, int n) {
+    return (v + n - 1) / n * n;
+}
+
+// Multiply the MR rows of the packed weights by the NR columns of the
+// packed inputs over the depth kc, and write the tile in row order. The
+// accumulators are named one by one, the compilers keep the arrays of
+// vectors in the memory.
+static void gemm_kernel(int kc, const float *a, const float *b, float *tile) {
+#if defined(__AVX512F__)
+#define GEMM_ROW(r)                                                  \
+    const __m512 w##r = _mm512_set1_ps(a[r]);                        \
+    c##r##0 = _mm512_fmadd_ps(w##r, b0, c##r##0);                    \
+    c##r##1 = _mm512_fmadd_ps(w##r, b1, c##r##1);
+#define GEMM_STORE(r)                                                \
+    _mm512_storeu_ps(tile + r * GEMM_NR, c##r##0);                   \
+    _mm512_storeu_ps(tile + r * GEMM_NR + 16, c##r##1);
+
+    __m512 c00 = _mm512_setzero_ps(), c01 = c00, c10 = c00, c11 = c00;
+    __m512 c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    __m512 c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    __m512 c60 = c00, c61 = c00, c70 = c00, c71 = c00;
+    for (int k = 0; k < kc; ++k) {
+        const __m512 b0 = _mm512_loadu_ps(b);
+        const __m512 b1 = _mm512_loadu_ps(b + 16);
+        GEMM_ROW(0) GEMM_ROW(1) GEMM_ROW(2) GEMM_ROW(3)
+        GEMM_ROW(4) GEMM_ROW(5) GEMM_ROW(6) GEMM_ROW(7)
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    GEMM_STORE(0) GEMM_STORE(1) GEMM_STORE(2) GEMM_STORE(3)
+    GEMM_STORE(4) GEMM_STORE(5) GEMM_STORE(6) GEMM_STORE(7)
+#elif defined(__AVX2__) && defined(__FMA__)
+#define GEMM_ROW(r)                                                  \
+    const __m256 w##r = _mm256_broadcast_ss(a + r);                  \
+    c##r##0 = _mm256_fmadd_ps(w##r, b0, c##r##0);                    \
+    c##r##1 = _mm256_fmadd_ps(w##r, b1, c##r##1);
+#define GEMM_STORE(r)                                                \
+    _mm256_storeu_ps(tile + r * GEMM_NR, c##r##0);                   \
+    _mm256_storeu_ps(tile + r * GEMM_NR + 8, c##r##1);
+
+    __m256 c00 = _mm256_setzero_ps(), c01 = c00, c10 = c00, c11 = c00;
+    __m256 c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    __m256 c40 = c00, c41 = c00, c50 = c00, c51 = c00;
+    for (int k = 0; k < kc; ++k) {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        const __m256 b1 = _mm256_loadu_ps(b + 8);
+        GEMM_ROW(0) GEMM_ROW(1) GEMM_ROW(2)
+        GEMM_ROW(3) GEMM_ROW(4) GEMM_ROW(5)
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    GEMM_STORE(0) GEMM_STORE(1) GEMM_STORE(2)
+    GEMM_STORE(3) GEMM_STORE(4) GEMM_STORE(5)
+#else
+    float acc[GEMM_MR * GEMM_NR] = {};
+    for (int k = 0; k < kc; ++k) {
+        for (int r = 0; r < GEMM_MR; ++r) {
+            const float w = a[r];
+            for (int c = 0; c < GEMM_NR; ++c) {
+                acc[r * GEMM_NR + c] += w * b[c];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+    std::copy(acc, acc + GEMM_MR * GEMM_NR, tile);
+#endif
+#undef GEMM_ROW
+#undef GEMM_STORE
+}
+
+// Write the tile to the outputs. The first depth block stores it and the
+// later ones add it. The last one also adds the bias and the residual,
+// then applies ReLU.
+static void store_tile(const float *tile, int rows, int columns,
+                           float *output, const float *residual, int stride,
+                           const float *biases, bool first, bool last) {
+    for (int r = 0; r < rows; ++r) {
+        const float *t = tile + r * GEMM_NR;
+        float *out = output + r * stride;
+
+        if (first) {
+            std::copy(t, t + columns, out);
+        } else {
+            for (int c = 0; c < columns; ++c) {
+                out[c] += t[c];
+            }
+        }
+        if (last) {
+            const float *res = residual ? residual + r * stride : nullptr;
+            for (int c = 0; c < columns; ++c) {
+                float v = out[c] + biases[r];
+                if (res) {
+                    v += res[c];
+                }
+                out[c] = std::max(v, 0.f);
+            }
+        }
+    }
+}
+
+void CpuBackend::init_layers(int filters, int blocks, int value_hidden) {
+    m_filters = filters;
+    m_blocks = blocks;
+    m_value_hidden = value_hidden;
+
+    m_tower.resize(1 + 2 * blocks);
+    for (int i = 0; i < static_cast<int>(m_tower.size()); ++i) {
+        auto &layer = m_tower[i];
+        layer.in_channels = i == 0 ? Features::INPUT_CHANNELS : filters;
+        layer.out_channels = filters;
+        layer.kernel_size = 3;
+
+        const int kernel_area = layer.kernel_size * layer.kernel_size;
+        layer.weights.assign(filters * layer.in_channels * kernel_area, 0.f);
+        layer.biases.assign(filters, 0.f);
+        layer.bn_means.assign(filters, 0.f);
+        layer.bn_vars.assign(filters, 1.f);
+    }
+
+    m_policy_weights.assign(filters, 0.f);
+    m_policy_bias.assign(1, 0.f);
+    m_pass_weights.assign(filters, 0.f);
+    m_pass_bias.assign(1, 0.f);
+    m_value_weights1.assign(value_hidden * filters, 0.f);
+    m_value_biases1.assign(value_hidden, 0.f);
+    m_value_weights2.assign(value_hidden, 0.f);
+    m_value_bias2.assign(1, 0.f);
+}
+
+bool CpuBackend::visit_tensors(const std::function<bool(std::vector<float> &)> &visitor) {
+    for (auto &layer : m_tower) {
+        if (!visitor(layer.weights) ||
+                !visitor(layer.biases) ||
+                !visitor(layer.bn_means) ||
+                !visitor(layer.bn_vars)) {
+            return false;
+        }
+    }
+    return visitor(m_policy_weights) &&
+               visitor(m_policy_bias) &&
+               visitor(m_pass_weights) &&
+               visitor(m_pass_bias) &&
+               visitor(m_value_weights1) &&
+               visitor(m_value_biases1) &&
+               visitor(m_value_weights2) &&
+               visitor(m_value_bias2);
+}
+
+void CpuBackend::prepare_layers() {
+    for (auto &layer : m_tower) {
+        const int depth = layer.in_channels * layer.kernel_size * layer.kernel_size;
+        const int rows = round_up(layer.out_channels, GEMM_MR);
+
+        // (x + bias - mean) * scale is x * scale + (bias - mean) * scale.
+        layer.packed_weights.assign(rows * depth, 0.f);
+        layer.folded_biases.resize(layer.out_channels);
+
+        for (int o = 0; o < layer.out_channels; ++o) {
+            const float scale = 1.f / std::sqrt(layer.bn_vars[o] + BN_EPSILON);
+            layer.folded_biases[o] = (layer.biases[o] - layer.bn_means[o]) * scale;
+
+            // The panel of MR rows is in [depth][MR] order.
+            float *panel = &layer.packed_weights[(o / GEMM_MR) * GEMM_MR * depth];
+            for (int k = 0; k < depth; ++k) {
+                panel[k * GEMM_MR + o % GEMM_MR] = layer.weights[o * depth + k] * scale;
+            }
+        }
+    }
+}
+
+void CpuBackend::init_random(int filters, int blocks, std::uint64_t seed) {
+    init_layers(std::max(filters, 1), std::max(blocks, 0), 32);
+
+    Random rng(seed);
+    const auto fill = [&rng](std::vector<float> &v, int fan_in) {
+        // The uniform He initialization.
+        const float limit = std::sqrt(6.f / fan_in);
+        for (auto &w : v) {
+            w = (2.f * rng.randfloat() - 1.f) * limit;
+        }
+    };
+
+    for (auto &layer : m_tower) {
+        fill(layer.weights, layer.in_channels * layer.kernel_size * layer.kernel_size);
+    }
+    fill(m_policy_weights, m_filters);
+    fill(m_pass_weights, m_filters);
+    fill(m_value_weights1, m_filters);
+    fill(m_value_weights2, m_value_hidden);
+
+    prepare_layers();
+}
+
+// Read one line of floats into the tensor. Return false if the size is
+// not the same.
+static bool read_tensor(std::istream &in, std::vector<float> &tensor) {
+    std::string line;
+    if (!std::getline(in, line)) {
+        return false;
+    }
+    std::istringstream iss(line);
+    std::size_t size = 0;
+    float w;
+    while (iss >> w) {
+        if (size == tensor.size()) {
+            return false;
+        }
+        tensor[size++] = w;
+    }
+    return size == tensor.size();
+}
+
+static std::uint32_t get_u32(const std::uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+static float get_float(const std::uint8_t *p) {
+    const std::uint32_t bits = get_u32(p);
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static void put_u32(std::vector<std::uint8_t> &buf, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        buf.emplace_back((v >> (8 * i)) & 0xff);
+    }
+}
+
+static void put_float(std::vector<std::uint8_t> &buf, float v) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    put_u32(buf, bits);
+}
+
+bool CpuBackend::load_weights(const std::string &filename) {
+    MappedFile file;
+    if (!file.open(filename, true)) {
+        return false;
+    }
+    const auto *data = reinterpret_cast<const std::uint8_t *>(file.data());
+    const std::size_t size = file.size();
+
+    // The input channels, filters, blocks and value hidden size.
+    int shape[4];
+    std::function<bool(std::vector<float> &)> reader;
+
+    std::size_t offset = 0;
+    std::istringstream text;
+
+    if (size >= sizeof(BINARY_MAGIC) &&
+            std::memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+        offset = sizeof(BINARY_MAGIC);
+        if (size < offset + 5 * 4 || get_u32(data + offset) != BINARY_VERSION) {
+            return false;
+        }
+        offset += 4;
+        for (auto &s : shape) {
+            s = static_cast<int>(get_u32(data + offset));
+            offset += 4;
+        }
+        reader = [data, size, &offset](std::vector<float> &tensor) {
+            if ((size - offset) / 4 < tensor.size()) {
+                return false;
+            }
+            for (auto &w : tensor) {
+                w = get_float(data + offset);
+                offset += 4;
+            }
+            return true;
+        };
+    } else {
+        text.str(std::string(file.data(), size));
+        std::string line;
+        if (!std::getline(text, line) || line.compare(0, 7, "gonet 1") != 0 ||
+                !std::getline(text, line)) {
+            return false;
+        }
+        std::istringstream iss(line);
+        if (!(iss >> shape[0] >> shape[1] >> shape[2] >> shape[3])) {
+            return false;
+        }
+        reader = [&text](std::vector<float> &tensor) {
+            return read_tensor(text, tensor);
+        };
+    }
+
+    if (shape[0] != Features::INPUT_CHANNELS ||
+            shape[1] <= 0 || shape[2] < 0 || shape[3] <= 0) {
+        return false;
+    }
+    init_layers(shape[1], shape[2], shape[3]);
+
+    if (!visit_tensors(reader)) {
+        return false;
+    }
+    if (offset != 0 && offset != size) {
+        // The binary weights are longer than the shape.
+        return false;
+    }
+    prepare_layers();
+    return true;
+}
+
+bool CpuBackend::save_weights(const std::string &filename) {
+    std::vector<std::uint8_t> buf;
+    for (auto c : BINARY_MAGIC) {
+        buf.emplace_back(c);
+    }
+    put_u32(buf, BINARY_VERSION);
+    put_u32(buf, Features::INPUT_CHANNELS);
+    put_u32(buf, m_filters);
+    put_u32(buf, m_blocks);
+    put_u32(buf, m_value_hidden);
+
+    visit_tensors([&buf](std::vector<float> &tensor) {
+        for (auto w : tensor) {
+            put_float(buf, w);
+        }
+        return true;
+    });
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+    return static_cast<bool>(file);
+}
+
+void CpuBackend::convolve(const ConvLayer &layer, int board_size, int batch_size,
+                              const float *input, float *output,
+                              const float *residual) {
+    const int num_intersections = board_size * board_size;
+    const int kernel_size = layer.kernel_size;
+    const int kernel_area = kernel_size * kernel_size;
+    const int pad = kernel_size / 2;
+
+    // The GEMM of the weights [rows][depth] and the im2col of the inputs
+    // [depth][columns].
+    const int rows = layer.out_channels;
+    const int depth = layer.in_channels * kernel_area;
+    const int columns = batch_size * num_intersections;
+
+    m_packed_inputs.resize(GEMM_KC * GEMM_NC);
+    m_im2col_row.assign(GEMM_NC, 0.f);
+    float *row = m_im2col_row.data();
+
+    alignas(64) float tile[GEMM_MR * GEMM_NR];
+
+    for (int jc = 0; jc < columns; jc += GEMM_NC) {
+        const int nc = std::min(GEMM_NC, columns - jc);
+        const int panels = round_up(nc, GEMM_NR) / GEMM_NR;
+
+        for (int pc = 0; pc < depth; pc += GEMM_KC) {
+            const int kc = std::min(GEMM_KC, depth - pc);
+
+            // Pack the im2col block in panels of NR columns, each one is
+            // in [depth][NR] order. The points out of the board and the
+            // padding columns are zero.
+            for (int k = 0; k < kc; ++k) {
+                const int channel = (pc + k) / kernel_area;
+                const int dy = (pc + k) % kernel_area / kernel_size - pad;
+                const int dx = (pc + k) % kernel_area % kernel_size - pad;
+                const float *plane = input + channel * columns;
+
+                // Build the row by the segments of the board rows, each
+                // one is the shifted board row.
+                for (int j = 0; j < nc; ) {
+                    const int column = jc + j;
+                    const int idx = column % num_intersections;
+                    const int x = idx % board_size;
+                    const int y = idx / board_size + dy;
+                    const int length = std::min(board_size - x, nc - j);
+
+                    float *dst = row + j;
+                    if (y < 0 || y >= board_size) {
+                        std::fill(dst, dst + length, 0.f);
+                    } else {
+                        const float *src = plane + (column - idx) + y * board_size + dx;
+                        const int begin = std::max(x, -dx);
+                        const int end = std::max(begin, std::min(x + length, board_size - dx));
+
+                        std::fill(dst, dst + (begin - x), 0.f);
+                        std::copy(src + begin, src + end, dst + (begin - x));
+                        std::fill(dst + (end - x), dst + length, 0.f);
+                    }
+                    j += length;
+                }
+                for (int p = 0; p < panels; ++p) {
+                    std::copy(row + p * GEMM_NR, row + (p + 1) * GEMM_NR,
+                                  m_packed_inputs.data() + (p * kc + k) * GEMM_NR);
+                }
+            }
+
+            const bool first = pc == 0;
+            const bool last = pc + kc == depth;
+
+            for (int ir = 0; ir < rows; ir += GEMM_MR) {
+                const float *a = layer.packed_weights.data() + ir * depth + pc * GEMM_MR;
+                const int offset = ir * columns + jc;
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    gemm_kernel(kc, a, m_packed_inputs.data() + jr * kc, tile);
+                    store_tile(tile, std::min(GEMM_MR, rows - ir), std::min(GEMM_NR, nc - jr),
+                                   output + offset + jr,
+                                   residual ? residual + offset + jr : nullptr,
+                                   columns, layer.folded_biases.data() + ir, first, last);
+                }
+            }
+        }
+    }
+}
+
+void CpuBackend::forward_heads(int board_size, int batch_size, int index,
+                                   const float *tower, NetResult &result) {
+    const int num_intersections = board_size * board_size;
+    const int stride = batch_size * num_intersections;
+    tower += index * num_intersections;
+
+    // The average pooling.
+    auto &pooled = m_pooled;
+    pooled.resize(m_filters);
+    for (int c = 0; c < m_filters; ++c) {
+        const float *plane = tower + c * stride;
+        float sum = 0.f;
+        for (int idx = 0; idx < num_intersections; ++idx) {
+            sum += plane[idx];
+        }
+        pooled[c] = sum / num_intersections;
+    }
+
+    // The policy head, softmax over the points and pass.
+    auto &policy = result.policy;
+    std::fill(std::begin(policy), std::begin(policy) + num_intersections, m_policy_bias[0]);
+    for (int c = 0; c < m_filters; ++c) {
+        const float *plane = tower + c * stride;
+        const float w = m_policy_weights[c];
+        for (int idx = 0; idx < num_intersections; ++idx) {
+            policy[idx] += w * plane[idx];
+        }
+    }
+    float pass_logit = m_pass_bias[0];
+    for (int c = 0; c < m_filters; ++c) {
+        pass_logit += m_pass_weights[c] * pooled[c];
+    }
+    policy[num_intersections] = pass_logit;
+
+    const float max_logit = *std::max_element(std::begin(policy),
+                                                  std::begin(policy) + num_intersections + 1);
+    float sum = 0.f;
+    for (int idx = 0; idx <= num_intersections; ++idx) {
+        policy[idx] = std::exp(policy[idx] - max_logit);
+        sum += policy[idx];
+    }
+    for (int idx = 0; idx <= num_intersections; ++idx) {
+        policy[idx] /= sum;
+    }
+
+    // The value head.
+    float value = m_value_bias2[0];
+    for (int h = 0; h < m_value_hidden; ++h) {
+        float hidden = m_value_biases1[h];
+        for (int c = 0; c < m_filters; ++c) {
+            hidden += m_value_weights1[h * m_filters + c] * pooled[c];
+        }
+        value += m_value_weights2[h] * std::max(hidden, 0.f);
+    }
+    result.value = std::tanh(value);
+}
+
+void CpuBackend::forward(int board_size, int batch_size,
+                             const float *inputs, NetResult *results) {
+    const int num_intersections = board_size * board_size;
+    const int input_size = Features::get_input_size(board_size);
+    const int columns = batch_size * num_intersections;
+
+    // The inputs are in [batch][channel][point] order, but the tower is
+    // in [channel][batch][point] order, so the batch is in the columns
+    // of the GEMM.
+    m_input.resize(Features::INPUT_CHANNELS * columns);
+    for (int b = 0; b < batch_size; ++b) {
+        for (int c = 0; c < Features::INPUT_CHANNELS; ++c) {
+            const float *plane = inputs + b * input_size + c * num_intersections;
+            std::copy(plane, plane + num_intersections,
+                          m_input.data() + c * columns + b * num_intersections);
+        }
+    }
+
+    for (auto &buffer : m_buffers) {
+        buffer.resize(m_filters * columns);
+    }
+    float *x = m_buffers[0].data();
+    float *t = m_buffers[1].data();
+    float *y = m_buffers[2].data();
+
+    convolve(m_tower[0], board_size, batch_size, m_input.data(), x, nullptr);
+    for (int b = 0; b < m_blocks; ++b) {
+        convolve(m_tower[1 + 2 * b], board_size, batch_size, x, t, nullptr);
+        convolve(m_tower[2 + 2 * b], board_size, batch_size, t, y, x);
+        std::swap(x, y);
+    }
+
+    for (int b = 0; b < batch_size; ++b) {
+        forward_heads(board_size, batch_size, b, x, results[b]);
+    }
+}
+
+std::string CpuBackend::get_name() const {
+#if defined(__AVX512F__)
+    return "cpu avx512";
+#elif defined(__AVX2__) && defined(__FMA__)
+    return "cpu avx2";
+#else
+    return "cpu";
+#endif
+}
+
+int CpuBackend::get_filters() const {
+    return m_filters;
+}
+
+int CpuBackend::get_blocks() const {
+    return m_blocks;
+}
@@ -0,0 +1,130 @@
+#ifndef CPU_BACKEND_H_INCLUDE
+#define CPU_BACKEND_H_INCLUDE
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "network.h"
+
+// The residual network on the CPU. The heads are fully convolutional, so
+// one set of weights works on every board size.
+//
+//   input    3x3 conv, batch norm, ReLU
+//   tower    residual blocks of two 3x3 convs with batch norm
+//   policy   1x1 conv to one logit per point, the pass logit from the
+//            average pooling of tower
+//   value    average pooling of tower, FC with ReLU, FC with tanh
+//
+// The batch norm is folded into the conv weights after loading. Every
+// conv of the batch is one matrix multiplication, the weights times the
+// im2col of the inputs, which is cache-blocked and uses AVX2 or AVX-512
+// if the compiler targets them.
+class CpuBackend : public NetworkBackend {
+public:
+    // Load the text or binary weights.
+    //
+    // The first line of the text weights is "gonet 1", the second is the
+    // input channels, filters, blocks and value hidden size, then one
+    // tensor per line in the order of the layers above. Every conv has
+    // weights, biases, batch norm means and variances.
+    //
+    // The binary weights start with the 8 bytes "gonetbin", then the
+    // version and the four sizes as 32-bit integers, then the same
+    // tensors as 32-bit floats. Both are little-endian.
+    //
+    // Return false if the file is broken.
+    bool load_weights(const std::string &filename);
+
+    // Write the binary weights. Return false if the file could not be
+    // written.
+    bool save_weights(const std::string &filename);
+
+    // Use the random weights, for testing the pipeline and speed.
+    void init_random(int filters, int blocks, std::uint64_t seed);
+
+    void forward(int board_size, int batch_size,
+                     const float *inputs, NetResult *results) override;
+
+    std::string get_name() const override;
+
+    int get_filters() const;
+    int get_blocks() const;
+
+private:
+    static constexpr float BN_EPSILON = 1e-5f;
+
+    static constexpr char BINARY_MAGIC[8] = {'g', 'o', 'n', 'e', 't', 'b', 'i', 'n'};
+
+    static constexpr int BINARY_VERSION = 1;
+
+    struct ConvLayer {
+        int in_channels;
+        int out_channels;
+        int kernel_size;
+
+        // The weights are in [out][in][ky][kx] order.
+        std::vector<float> weights;
+        std::vector<float> biases;
+        std::vector<float> bn_means;
+        std::vector<float> bn_vars;
+
+        // The weights with the batch norm folded in, packed in panels
+        // of the GEMM rows. The out channels are padded to the panels.
+        std::vector<float> packed_weights;
+        std::vector<float> folded_biases;
+    };
+
+    // Allocate the layers for the shape.
+    void init_layers(int filters, int blocks, int value_hidden);
+
+    // Call the visitor with every tensor in the file order. Stop and
+    // return false if it returns false.
+    bool visit_tensors(const std::function<bool(std::vector<float> &)> &visitor);
+
+    // Fold the batch norm and pack the weights of every conv.
+    void prepare_layers();
+
+    // Run the conv with the batch norm on the batch. Add the residual, if
+    // any, and apply ReLU. The tensors are in [channel][batch][point]
+    // order.
+    void convolve(const ConvLayer &layer, int board_size, int batch_size,
+                      const float *input, float *output,
+                      const float *residual);
+
+    // Evaluate the heads of one position of the tower outputs.
+    void forward_heads(int board_size, int batch_size, int index,
+                           const float *tower, NetResult &result);
+
+    int m_filters{0};
+    int m_blocks{0};
+    int m_value_hidden{0};
+
+    // The input conv and two convs per residual block.
+    std::vector<ConvLayer> m_tower;
+
+    std::vector<float> m_policy_weights;
+    std::vector<float> m_policy_bias;
+
+    std::vector<float> m_pass_weights;
+    std::vector<float> m_pass_bias;
+
+    std::vector<float> m_value_weights1;
+    std::vector<float> m_value_biases1;
+    std::vector<float> m_value_weights2;
+    std::vector<float> m_value_bias2;
+
+    // The reused buffers of the tower.
+    std::vector<float> m_input;
+    std::vector<float> m_buffers[3];
+
+    // The packed im2col block of the GEMM, and one row of it before
+    // packing.
+    std::vector<float> m_packed_inputs;
+    std::vector<float> m_im2col_row;
+
+    std::vector<float> m_pooled;
+};
+
+#endif
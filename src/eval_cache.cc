@@ -0,0 +1,145 @@
+#include "eval_cache.h"
+#include "symmetry.h"
+#include "zobrist.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+
+constexpr int EvalCache::NUM_LOCKS;
+
+// The key of the last move. The network sees the last move, so the same
+// stones after the different moves are the different entries.
+static std::uint64_t get_last_move_key(int vtx) {
+    const auto key = Zobrist::KO_MOVE[vtx];
+    return (key << 32) | (key >> 32);
+}
+
+// The key of the board size, the finalizer of splitmix64.
+static std::uint64_t get_size_key(int board_size) {
+    std::uint64_t key = board_size;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+EvalCache::EvalCache() {
+    m_locks.reset(new std::mutex[NUM_LOCKS]);
+    m_symmetry = false;
+    resize(64);
+}
+
+void EvalCache::resize(std::size_t megabytes) {
+    const std::size_t budget = std::max(megabytes, std::size_t{1}) * 1024 * 1024;
+
+    // Use a power of two number of entries, so the index is a mask.
+    std::size_t size = 1;
+    while (2 * size * sizeof(Entry) <= budget) {
+        size *= 2;
+    }
+
+    m_entries.reset(new Entry[size]);
+    m_mask = size - 1;
+    m_size_mb = std::max(megabytes, std::size_t{1});
+    clear();
+}
+
+void EvalCache::clear() {
+    for (std::uint64_t i = 0; i <= m_mask; ++i) {
+        m_entries[i].key = 0;
+    }
+    reset_counters();
+}
+
+void EvalCache::set_symmetry(bool symmetry) {
+    m_symmetry = symmetry;
+    clear();
+}
+
+std::uint64_t EvalCache::compute_key(const Board &board, int &symmetry) const {
+    const int board_size = board.get_board_size();
+
+    // The hash has the side to move and the ko move already.
+    std::uint64_t hash;
+    if (m_symmetry) {
+        hash = Symmetry::get_canonical_hash(board, symmetry);
+    } else {
+        hash = board.get_hash();
+        symmetry = Symmetry::IDENTITY;
+    }
+
+    const int last_move = board.get_last_move();
+    if (last_move != Board::NULL_VERTEX && last_move != Board::PASS) {
+        hash ^= get_last_move_key(Symmetry::transform_vertex(symmetry, last_move, board_size));
+    }
+    return hash ^ get_size_key(board_size);
+}
+
+bool EvalCache::probe(const Board &board, NetResult &result) {
+    m_probes.fetch_add(1, std::memory_order_relaxed);
+    PERF_COUNT(CACHE_PROBES);
+
+    int symmetry;
+    const auto key = compute_key(board, symmetry);
+    const auto slot = key & m_mask;
+
+    std::lock_guard<std::mutex> lock(m_locks[slot % NUM_LOCKS]);
+    const auto &entry = m_entries[slot];
+    if (key == 0 || entry.key != key) {
+        return false;
+    }
+
+    const int board_size = board.get_board_size();
+    const int num_intersections = board_size * board_size;
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        result.policy[idx] = entry.result.policy[Symmetry::transform_index(symmetry, idx, board_size)];
+    }
+    result.policy[num_intersections] = entry.result.policy[num_intersections];
+    result.value = entry.result.value;
+
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    PERF_COUNT(CACHE_HITS);
+    return true;
+}
+
+void EvalCache::store(const Board &board, const NetResult &result) {
+    int symmetry;
+    const auto key = compute_key(board, symmetry);
+    const auto slot = key & m_mask;
+
+    std::lock_guard<std::mutex> lock(m_locks[slot % NUM_LOCKS]);
+    auto &entry = m_entries[slot];
+
+    const int board_size = board.get_board_size();
+    const int num_intersections = board_size * board_size;
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        entry.result.policy[Symmetry::transform_index(symmetry, idx, board_size)] = result.policy[idx];
+    }
+    entry.result.policy[num_intersections] = result.policy[num_intersections];
+    entry.result.value = result.value;
+    entry.key = key;
+}
+
+void EvalCache::reset_counters() {
+    m_probes.store(0);
+    m_hits.store(0);
+}
+
+std::uint64_t EvalCache::get_probes() const {
+    return m_probes.load();
+}
+
+std::uint64_t EvalCache::get_hits() const {
+    return m_hits.load();
+}
+
+std::size_t EvalCache::get_size_mb() const {
+    return m_size_mb;
+}
+
+std::size_t EvalCache::get_num_entries() const {
+    return m_mask + 1;
+}
+
+bool EvalCache::get_symmetry() const {
+    return m_symmetry;
+}
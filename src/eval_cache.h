@@ -0,0 +1,80 @@
+#ifndef EVAL_CACHE_H_INCLUDE
+#define EVAL_CACHE_H_INCLUDE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "board.h"
+#include "network.h"
+
+// The fixed size cache of the network results keyed by the position,
+// shared by all search threads and self-play games. The entries are
+// direct mapped, a new result replaces the old one in its slot. Each
+// stripe of entries has its own lock, because a result is too large to
+// write atomically.
+//
+// In the symmetry mode, the key is the smallest key of the 8 rotations
+// and reflections of the position, and the policy is stored in that
+// orientation, so the symmetric positions share one entry.
+class EvalCache {
+public:
+    EvalCache();
+
+    // Reallocate the cache with the memory budget in megabytes. All
+    // entries are dropped.
+    void resize(std::size_t megabytes);
+
+    // Drop all entries and reset the counters.
+    void clear();
+
+    // Turn the symmetry mode on or off. All entries are dropped, because
+    // the keys of two modes are different.
+    void set_symmetry(bool symmetry);
+
+    // Return true and fill the result if the position is in the cache.
+    bool probe(const Board &board, NetResult &result);
+
+    // Store the result of the position.
+    void store(const Board &board, const NetResult &result);
+
+    // Reset the probes and hits counters.
+    void reset_counters();
+
+    std::uint64_t get_probes() const;
+    std::uint64_t get_hits() const;
+    std::size_t get_size_mb() const;
+    std::size_t get_num_entries() const;
+    bool get_symmetry() const;
+
+private:
+    static constexpr int NUM_LOCKS = 64;
+
+    struct Entry {
+        // Zero if the entry is empty.
+        std::uint64_t key;
+        NetResult result;
+    };
+
+    // Compute the key of the position. In the symmetry mode, also give
+    // the symmetry which maps the position to the stored orientation.
+    std::uint64_t compute_key(const Board &board, int &symmetry) const;
+
+    std::unique_ptr<Entry[]> m_entries;
+
+    std::unique_ptr<std::mutex[]> m_locks;
+
+    std::uint64_t m_mask;
+
+    std::size_t m_size_mb;
+
+    bool m_symmetry;
+
+    std::atomic<std::uint64_t> m_probes;
+
+    std::atomic<std::uint64_t> m_hits;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "evaluator.h"
+
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+BatchEvaluator::BatchEvaluator(std::unique_ptr<NetworkBackend> backend,
+                                   int max_batch_size, int timeout_us) {
+    m_backend = std::move(backend);
+    m_max_batch_size = std::max(max_batch_size, 1);
+    m_timeout_us = std::max(timeout_us, 0);
+    m_stop = false;
+
+    m_batch.reserve(m_max_batch_size);
+    m_batch_inputs.resize(m_max_batch_size * Features::get_input_size(Board::BOARD_SIZE));
+    m_batch_results.resize(m_max_batch_size);
+    reset_counters();
+
+    m_dispatcher = std::thread(&BatchEvaluator::dispatch, this);
+}
+
+BatchEvaluator::~BatchEvaluator() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_queue_cv.notify_one();
+    m_dispatcher.join();
+}
+
+void BatchEvaluator::evaluate(const Board &board, NetResult &result) {
+    if (m_cache && m_cache->probe(board, result)) {
+        return;
+    }
+
+    float inputs[Features::INPUT_CHANNELS * Board::NUM_INTESECTIONS];
+    Features::encode(board, inputs);
+
+    Request request;
+    request.board_size = board.get_board_size();
+    request.inputs = inputs;
+    request.result = &result;
+    request.done = false;
+    request.start = Clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queue.emplace_back(&request);
+    m_queue_cv.notify_one();
+
+    m_done_cv.wait(lock, [&request]() { return request.done; });
+    lock.unlock();
+
+    if (m_cache) {
+        m_cache->store(board, result);
+    }
+}
+
+void BatchEvaluator::dispatch() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+        m_queue_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            return;
+        }
+
+        // Wait for the full batch, or until the oldest request waited
+        // for the timeout.
+        const auto deadline = m_queue.front()->start + std::chrono::microseconds(m_timeout_us);
+        m_queue_cv.wait_until(lock, deadline, [this]() {
+            return m_stop || static_cast<int>(m_queue.size()) >= m_max_batch_size;
+        });
+
+        // Take the requests of the same board size as the oldest one.
+        const int board_size = m_queue.front()->board_size;
+        m_batch.clear();
+        for (auto it = std::begin(m_queue);
+                 it != std::end(m_queue) && static_cast<int>(m_batch.size()) < m_max_batch_size;) {
+            if ((*it)->board_size == board_size) {
+                m_batch.emplace_back(*it);
+                it = m_queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lock.unlock();
+
+        const int input_size = Features::get_input_size(board_size);
+        const int batch_size = m_batch.size();
+        for (int b = 0; b < batch_size; ++b) {
+            std::copy(m_batch[b]->inputs, m_batch[b]->inputs + input_size,
+                          m_batch_inputs.data() + b * input_size);
+        }
+
+        m_backend->forward(board_size, batch_size,
+                               m_batch_inputs.data(), m_batch_results.data());
+
+        for (int b = 0; b < batch_size; ++b) {
+            *m_batch[b]->result = m_batch_results[b];
+        }
+        m_evaluations.fetch_add(batch_size, std::memory_order_relaxed);
+        m_batches.fetch_add(1, std::memory_order_relaxed);
+
+        lock.lock();
+        for (auto request : m_batch) {
+            request->done = true;
+        }
+        m_done_cv.notify_all();
+    }
+}
+
+std::uint64_t BatchEvaluator::get_evaluations() const {
+    return m_evaluations.load();
+}
+
+std::uint64_t BatchEvaluator::get_batches() const {
+    return m_batches.load();
+}
+
+void BatchEvaluator::reset_counters() {
+    m_evaluations.store(0);
+    m_batches.store(0);
+}
+
+void BatchEvaluator::set_cache(std::shared_ptr<EvalCache> cache) {
+    m_cache = cache;
+}
+
+EvalCache *BatchEvaluator::get_cache() {
+    return m_cache.get();
+}
+
+int BatchEvaluator::get_max_batch_size() const {
+    return m_max_batch_size;
+}
+
+NetworkBackend &BatchEvaluator::get_backend() {
+    return *m_backend;
+}
@@ -0,0 +1,92 @@
+#ifndef EVALUATOR_H_INCLUDE
+#define EVALUATOR_H_INCLUDE
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "eval_cache.h"
+#include "network.h"
+
+// Collect the positions of many search threads into batches for the
+// network backend. The search threads block in evaluate() until their
+// result is ready. The dispatcher thread sends a batch when it is full
+// or the oldest request has waited for the timeout. If the cache is set,
+// the cached positions do not wait at all.
+class BatchEvaluator {
+public:
+    BatchEvaluator(std::unique_ptr<NetworkBackend> backend,
+                       int max_batch_size, int timeout_us);
+    ~BatchEvaluator();
+
+    // Evaluate the board and wait for the result. It could be called
+    // from many threads at the same time.
+    void evaluate(const Board &board, NetResult &result);
+
+    // The evaluated positions and batches since the last reset.
+    std::uint64_t get_evaluations() const;
+    std::uint64_t get_batches() const;
+    void reset_counters();
+
+    // Use the cache of results. It should be set before the searches
+    // start. Null turns it off.
+    void set_cache(std::shared_ptr<EvalCache> cache);
+
+    EvalCache *get_cache();
+
+    int get_max_batch_size() const;
+
+    NetworkBackend &get_backend();
+
+private:
+    // One waiting position. It lives on the stack of the caller.
+    struct Request {
+        int board_size;
+        const float *inputs;
+        NetResult *result;
+        bool done;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // The loop of dispatcher thread.
+    void dispatch();
+
+    std::unique_ptr<NetworkBackend> m_backend;
+
+    std::shared_ptr<EvalCache> m_cache;
+
+    int m_max_batch_size;
+
+    int m_timeout_us;
+
+    std::mutex m_mutex;
+
+    // Wake up the dispatcher.
+    std::condition_variable m_queue_cv;
+
+    // Wake up the waiting search threads.
+    std::condition_variable m_done_cv;
+
+    std::deque<Request *> m_queue;
+
+    bool m_stop;
+
+    std::thread m_dispatcher;
+
+    // The batch buffers, only used by the dispatcher.
+    std::vector<Request *> m_batch;
+    std::vector<float> m_batch_inputs;
+    std::vector<NetResult> m_batch_results;
+
+    std::atomic<std::uint64_t> m_evaluations;
+    std::atomic<std::uint64_t> m_batches;
+};
+
+#endif
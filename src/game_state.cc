@@ -1,24 +1,33 @@
 #include "game_state.h"
-#include <random>
+#include "zobrist.h"
+#include "random.h"
+#include "perf_counters.h"
+
+#include <algorithm>
 
 void GameState::clear_board(int board_size, float komi) {
     board.reset_board(board_size);
+    board.set_pattern_weights(m_playout_policy == PATTERN_POLICY);
 
-    m_game_history.clear();
-    m_game_history.emplace_back(std::make_shared<Board>(board));
+    m_setup_stones.clear();
+    m_move_history.clear();
+    m_hash_history.clear();
+    m_hash_index.clear();
+    push_hash_index();
 
     m_komi = komi;
     m_movenum = 0;
 }
 
 bool GameState::play_move(int vtx, int color) {
-    if (!board.legal_move(vtx, color)) {
+    if (!legal_move(vtx, color)) {
         return false;
     }
     if (vtx != Board::RESIGN) {
         board.play_move_assume_legal(vtx, color);
-        m_game_history.resize(++m_movenum);
-        m_game_history.emplace_back(std::make_shared<Board>(board));
+        m_movenum++;
+        m_move_history.emplace_back(vtx, color);
+        push_hash_index();
     }
     return true;
 }
@@ -26,47 +35,136 @@ bool GameState::play_move(int vtx, int color) {
 void GameState::undo_move() {
     if (m_movenum <= 0) return;
 
-    m_game_history.resize(m_movenum--);
-    board = *m_game_history[m_movenum];
+    pop_hash_index();
+    board.undo_move();
+    m_move_history.pop_back();
+    m_movenum--;
 }
 
+std::uint64_t GameState::get_situational_hash(std::uint64_t ko_hash, int tomove) const {
+    if (tomove == Board::BLACK) {
+        return ko_hash ^ Zobrist::BLACK_TO_MOVE;
+    }
+    return ko_hash;
+}
 
-int GameState::play_random_move(int color) {
-    std::vector<int> legal_moves = { Board::PASS };
-    int board_size = board.get_board_size();
+void GameState::push_hash_index() {
+    const auto hash = get_situational_hash(board.get_ko_hash(), board.get_tomove());
+    m_hash_history.emplace_back(hash);
+    m_hash_index[hash]++;
+}
+
+void GameState::pop_hash_index() {
+    const auto hash = m_hash_history.back();
+    m_hash_history.pop_back();
+
+    auto it = m_hash_index.find(hash);
+    if (--(it->second) == 0) {
+        m_hash_index.erase(it);
+    }
+}
 
 
-    for (int y = 0; y < board_size; ++y) {
-        for (int x = 0; x < board_size; ++x) {
-            int vtx = board.get_vertex(x,y);
-            if (board.legal_move(vtx, color)) {
-                legal_moves.emplace_back(vtx);
-            }
+int GameState::play_random_move(int color) {
+    auto &rng = Random::get_rng();
+    if (m_playout_policy == PATTERN_POLICY) {
+        const int move = board.pattern_move(color, rng);
+        if (move != Board::PASS && legal_move(move, color)) {
+            play_move(move, color);
+            return move;
         }
     }
 
-    std::random_device rd;
-    std::mt19937 mt(rd());
-    std::uniform_int_distribution<> dist(0, legal_moves.size()-1);
+    std::vector<int> legal_moves = board.legal_moves(color);
+
+    legal_moves.erase(
+        std::remove_if(std::begin(legal_moves), std::end(legal_moves),
+                       [this, color](int vtx) {
+                           return board.is_eyeshape(vtx, color) ||
+                                      !legal_move(vtx, color);
+                       }),
+        std::end(legal_moves));
 
-    int move = legal_moves[dist(mt)];
+    int move = Board::PASS;
+    if (!legal_moves.empty()) {
+        move = legal_moves[rng.randfix(legal_moves.size())];
+    }
     play_move(move, color);
 
     return move;
 }
 
+float GameState::random_playout() const {
+    PERF_COUNT(PLAYOUTS);
+    PERF_TIMER(PLAYOUT_TIME);
+    auto &rng = Random::get_rng();
+
+    // The scratch board of the thread keeps its storage between the
+    // playouts. The playout moves are never undone, so they skip the
+    // journal.
+    static thread_local Board playout_board;
+    playout_board.copy_position(board);
+    playout_board.set_journal(false);
+
+    const int board_size = playout_board.get_board_size();
+    const int max_moves = 3 * board_size * board_size;
+
+    for (int i = 0; i < max_moves && playout_board.get_passes() < 2; ++i) {
+        const int color = playout_board.get_tomove();
+        const int move = m_playout_policy == PATTERN_POLICY ?
+                             playout_board.pattern_move(color, rng) :
+                             playout_board.random_move(color, rng);
+        playout_board.play_move_assume_legal(move, color);
+    }
+
+    return playout_board.compute_reach_color(Board::BLACK) -
+               playout_board.compute_reach_color(Board::WHITE) - m_komi;
+}
+
 bool GameState::legal_move(int vtx, int color) {
-    return board.legal_move(vtx, color);
+    if (!board.legal_move(vtx, color)) {
+        return false;
+    }
+    if (m_superko_rule == NO_SUPERKO ||
+            vtx == Board::PASS || vtx == Board::RESIGN) {
+        return true;
+    }
+
+    const auto ko_hash = board.compute_ko_hash_after(vtx, color);
+    const auto hash = get_situational_hash(ko_hash, !color);
+
+    if (m_hash_index.count(hash)) {
+        return false;
+    }
+    if (m_superko_rule == POSITIONAL_SUPERKO &&
+            m_hash_index.count(hash ^ Zobrist::BLACK_TO_MOVE)) {
+        // The same stones with the other side to move.
+        return false;
+    }
+    return true;
 }
 
-bool GameState::superko() {
-    std::uint64_t hash = board.compute_hash();
-    for (int i = 0; i < m_movenum-1; ++i) {
-        if (hash == m_game_history[i]->compute_hash()) {
-            return true;
+bool GameState::superko() const {
+    const auto hash = m_hash_history.back();
+    int repeats = m_hash_index.find(hash)->second;
+
+    auto it = m_hash_index.find(hash ^ Zobrist::BLACK_TO_MOVE);
+    if (it != std::end(m_hash_index)) {
+        repeats += it->second;
+    }
+
+    const int size = m_hash_history.size();
+    if (size >= 2) {
+        // Skip the previous position, like a pass.
+        const auto prev_hash = m_hash_history[size-2];
+        if (prev_hash == hash ||
+                prev_hash == (hash ^ Zobrist::BLACK_TO_MOVE)) {
+            repeats--;
         }
     }
-    return false;
+
+    // The current position is in the index too.
+    return repeats > 1;
 }
 
 float GameState::final_score() {
@@ -78,6 +176,10 @@ int GameState::get_vertex(int x, int y) const {
     return board.get_vertex(x,y);
 }
 
+std::string GameState::vertex_to_text(int vtx) const {
+    return board.vertex_to_text(vtx);
+}
+
 int GameState::get_index(int x, int y) const {
     return board.get_index(x,y);
 }
@@ -93,7 +195,7 @@ void GameState::showboard() {
                   << "Moves: " << m_movenum 
                   << "}"
                   << std::endl;
-    std::cerr << "Hash: " << std::hex << board.compute_hash() << std::endl;
+    std::cerr << "Hash: " << std::hex << board.get_hash() << std::dec << std::endl;
 }
 
 int GameState::get_state(int vtx) const {
@@ -132,10 +234,103 @@ float GameState::get_komi() const {
     return m_komi;
 }
 
+int GameState::get_movenum() const {
+    return m_movenum;
+}
+
+int GameState::get_move(int movenum) const {
+    return m_move_history[movenum-1].first;
+}
+
+int GameState::get_move_color(int movenum) const {
+    return m_move_history[movenum-1].second;
+}
+
 void GameState::set_komi(float komi) {
     m_komi = komi;
 }
 
 void GameState::set_to_move(int color) {
+    pop_hash_index();
     board.set_to_move(color);
+    push_hash_index();
+}
+
+bool GameState::set_setup_stone(int vtx, int color) {
+    if (m_movenum != 0 || board.get_state(vtx) == Board::INVLD) {
+        return false;
+    }
+
+    const auto it = std::find_if(std::begin(m_setup_stones), std::end(m_setup_stones),
+                                     [vtx](const std::pair<int, int> &stone) {
+                                         return stone.first == vtx;
+                                     });
+    if (it != std::end(m_setup_stones)) {
+        if (it->second == color) {
+            return true;
+        }
+        // Taking a stone away never leaves a string without liberty.
+        m_setup_stones.erase(it);
+        reset_setup_board();
+    }
+    if (color == Board::EMPTY) {
+        return true;
+    }
+
+    // Unlike a move, the setup stone captures nothing.
+    bool has_liberty = false;
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + board.get_direction(k);
+        const int state = board.get_state(avtx);
+        if (state == Board::EMPTY) {
+            has_liberty = true;
+        } else if (state == color) {
+            has_liberty |= board.get_atari_liberty(avtx) != vtx;
+        } else if (state == !color && board.get_atari_liberty(avtx) == vtx) {
+            return false;
+        }
+    }
+    if (!has_liberty) {
+        return false;
+    }
+
+    pop_hash_index();
+    board.set_stone(vtx, color);
+    push_hash_index();
+    m_setup_stones.emplace_back(vtx, color);
+    return true;
+}
+
+const std::vector<std::pair<int, int>> &GameState::get_setup_stones() const {
+    return m_setup_stones;
+}
+
+void GameState::reset_setup_board() {
+    const int tomove = board.get_tomove();
+
+    pop_hash_index();
+    board.reset_board(board.get_board_size());
+    board.set_pattern_weights(m_playout_policy == PATTERN_POLICY);
+    for (const auto &stone : m_setup_stones) {
+        board.set_stone(stone.first, stone.second);
+    }
+    board.set_to_move(tomove);
+    push_hash_index();
+}
+
+void GameState::set_superko_rule(int rule) {
+    m_superko_rule = rule;
+}
+
+int GameState::get_superko_rule() const {
+    return m_superko_rule;
+}
+
+void GameState::set_playout_policy(int policy) {
+    m_playout_policy = policy;
+    board.set_pattern_weights(m_playout_policy == PATTERN_POLICY);
+}
+
+int GameState::get_playout_policy() const {
+    return m_playout_policy;
 }
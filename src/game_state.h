@@ -4,22 +4,43 @@
 #include "board.h"
 
 #include <vector>
-#include <memory>
+#include <utility>
 #include <iostream>
+#include <unordered_map>
+#include <cstdint>
 
 class GameState {
 public:
+    enum superko_t {
+        NO_SUPERKO = 0,
+        POSITIONAL_SUPERKO = 1,
+        SITUATIONAL_SUPERKO = 2
+    };
+
+    enum playout_policy_t {
+        UNIFORM_POLICY = 0,
+        PATTERN_POLICY = 1
+    };
+
     // Return true if the move is legal and play it.
     bool play_move(int vtx, int color);
 
-    // Generate a random move and play it.
+    // Generate a random move by the playout policy and play it. It
+    // never fills our own eyes and passes only if there is no other
+    // move.
     int play_random_move(int color);
 
-    // Return true if the move is legal.
+    // Play the moves of the playout policy from the current position to
+    // the end of game and return the final score with Tromp-Taylor
+    // rule. The current board is not changed.
+    float random_playout() const;
+
+    // Return true if the move is legal. It also rejects the move which
+    // repeats a previous position if the superko rule is set.
     bool legal_move(int vtx, int color);
 
     // Return true if the current board is superko.
-    bool superko();
+    bool superko() const;
 
     // Undo the current move.
     void undo_move();
@@ -43,6 +64,9 @@ public:
     // Get the vertex position.
     int get_vertex(int x, int y) const;
 
+    // Transfer the vertex to GTP text.
+    std::string vertex_to_text(int vtx) const;
+
     // Get the index position.
     int get_index(int x, int y) const;
 
@@ -64,6 +88,15 @@ public:
     // Get the game komi.
     float get_komi() const;
 
+    // Get the number of played moves.
+    int get_movenum() const;
+
+    // Get the move played at the move number, starting from 1.
+    int get_move(int movenum) const;
+
+    // Get the color of move played at the move number, starting from 1.
+    int get_move_color(int movenum) const;
+
     // Get the current board state(black/white/empty) by the vertex 
     // position.
     int get_state(int vtx) const;
@@ -74,11 +107,61 @@ public:
     // Set the side to move color.
     void set_to_move(int color);
 
+    // Place a setup stone, or clear the point if the color is EMPTY. The
+    // setup stones are not moves, so they are allowed only before the
+    // first move. Return false if a string would be left without
+    // liberty.
+    bool set_setup_stone(int vtx, int color);
+
+    // Get the setup stones and their colors.
+    const std::vector<std::pair<int, int>> &get_setup_stones() const;
+
+    // Set the superko rule checked by legal_move(). The default is
+    // POSITIONAL_SUPERKO, so the search never repeats a position.
+    void set_superko_rule(int rule);
+
+    // Get the superko rule.
+    int get_superko_rule() const;
+
+    // Set the policy of play_random_move() and random_playout(). The
+    // default is UNIFORM_POLICY.
+    void set_playout_policy(int policy);
+
+    // Get the playout policy.
+    int get_playout_policy() const;
+
     // The current board.
     Board board;
 
 private:
-    std::vector<std::shared_ptr<const Board>> m_game_history;
+    // Return the situational hash, the positional hash with the side
+    // to move.
+    std::uint64_t get_situational_hash(std::uint64_t ko_hash, int tomove) const;
+
+    // Record the current position in the hash index.
+    void push_hash_index();
+
+    // Remove the current position from the hash index.
+    void pop_hash_index();
+
+    // Place the setup stones again on the empty board.
+    void reset_setup_board();
+
+    // The setup stones and their colors.
+    std::vector<std::pair<int, int>> m_setup_stones;
+
+    // The played moves and their colors.
+    std::vector<std::pair<int, int>> m_move_history;
+
+    // The situational hash per move.
+    std::vector<std::uint64_t> m_hash_history;
+
+    // The occurrences of each situational hash in the game history.
+    std::unordered_map<std::uint64_t, int> m_hash_index;
+
+    int m_superko_rule{POSITIONAL_SUPERKO};
+
+    int m_playout_policy{UNIFORM_POLICY};
 
     float m_komi;
 
@@ -1,272 +1,841 @@
 #include <memory>
-#include <sstream>
 #include <iostream>
-#include <vector>
+#include <string>
 #include <algorithm>
+#include <iterator>
 #include <cmath>
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <vector>
 
 #include "gtp.h"
 #include "game_state.h"
 #include "board.h"
+#include "search.h"
+#include "time_control.h"
+#include "sgf.h"
+#include "perf_counters.h"
+
+// The input lines read by the reader thread.
+static std::mutex input_mutex;
+static std::condition_variable input_cv;
+static std::deque<std::string> input_queue;
+
+// One GTP command split in place. The tokens point into the reused
+// buffer, so parsing allocates nothing once the buffer is large enough.
+class GtpCommand {
+public:
+    static constexpr int MAX_ARGS = 16;
+
+    // Split the line into the tokens. Return false if there is no
+    // command.
+    bool parse(const std::string &line);
+
+    // Return the i-th argument or the empty string.
+    const char *get_arg(int i) const;
+
+    // The command id, or -1 if there is no id.
+    int id;
+
+    // The command name is argv[0].
+    int argc;
+    const char *argv[MAX_ARGS];
+
+private:
+    std::string m_buffer;
+};
+
+bool GtpCommand::parse(const std::string &line) {
+    m_buffer.assign(line);
+    id = -1;
+    argc = 0;
+
+    // Remove the comments and turn the tabs and control characters
+    // into spaces.
+    char *c = &m_buffer[0];
+    for (char *p = c; *p != '\0'; ++p) {
+        const auto ch = static_cast<unsigned char>(*p);
+        if (ch == '#') {
+            *p = '\0';
+            break;
+        }
+        if (ch < ' ' || ch == 127) {
+            *p = ' ';
+        }
+    }
+
+    while (argc < MAX_ARGS) {
+        while (*c == ' ') ++c;
+        if (*c == '\0') break;
+
+        argv[argc++] = c;
+        while (*c != '\0' && *c != ' ') ++c;
+        if (*c != '\0') *c++ = '\0';
+    }
+
+    if (argc == 0) {
+        return false;
+    }
+
+    // check the command id here
+    bool is_digit = true;
+    for (const char *p = argv[0]; *p != '\0'; ++p) {
+        is_digit &= static_cast<bool>(std::isdigit(static_cast<unsigned char>(*p)));
+    }
+    if (is_digit) {
+        id = std::atoi(argv[0]);
+        std::copy(argv+1, argv+argc, argv); // remove command id
+        argc--;
+    }
+    return argc > 0;
+}
+
+const char *GtpCommand::get_arg(int i) const {
+    return i < argc ? argv[i] : "";
+}
+
+struct GtpContext {
+    GameState *main_game;
+    Search *search;
+    TimeControl *time_control;
+
+    GtpCommand command;
+
+    // The reused buffers of the response text and the whole response.
+    std::string response;
+    std::string output;
+
+    bool quit{false};
+
+    // Ponder after genmove until the next command comes.
+    bool ponder_enabled{false};
+    bool ponder_pending{false};
+
+    // The search is shared with other sessions, so the commands which
+    // change the engine are not available.
+    bool shared{false};
+
+    // The maximum moves of the game, or zero for no limit.
+    int max_moves{0};
+};
+
+using GtpFunction = bool (*)(GtpContext &);
+
+struct GtpHandler {
+    const char *name;
+    GtpFunction func;
+
+    // Show it in list_commands.
+    bool listed;
+};
+
+static void append_int(std::string &out, int value) {
+    char buf[16];
+    const int size = std::snprintf(buf, sizeof(buf), "%d", value);
+    out.append(buf, size);
+}
+
+static void append_float(std::string &out, float value) {
+    char buf[32];
+    const int size = std::snprintf(buf, sizeof(buf), "%g", value);
+    out.append(buf, size);
+}
+
+static bool parse_int(const char *str, int &value) {
+    char *end;
+    const long v = std::strtol(str, &end, 10);
+    if (end == str || *end != '\0') {
+        return false;
+    }
+    value = static_cast<int>(v);
+    return true;
+}
+
+static bool parse_float(const char *str, float &value) {
+    char *end;
+    const float v = std::strtof(str, &end);
+    if (end == str || *end != '\0') {
+        return false;
+    }
+    value = v;
+    return true;
+}
 
-static int command_id;
+static bool equal_nocase(const char *a, const char *b) {
+    for (; *a != '\0' && *b != '\0'; ++a, ++b) {
+        if (std::tolower(static_cast<unsigned char>(*a)) !=
+                std::tolower(static_cast<unsigned char>(*b))) {
+            return false;
+        }
+    }
+    return *a == *b;
+}
+
+static int parse_color(const char *str) {
+    const int c = std::tolower(static_cast<unsigned char>(str[0]));
+    if (c == 'b') {
+        return Board::BLACK;
+    } else if (c == 'w') {
+        return Board::WHITE;
+    }
+    return Board::INVLD;
+}
+
+static int parse_vertex(const GameState *main_game, const char *str) {
+    if (equal_nocase(str, "pass")) {
+        return Board::PASS;
+    } else if (equal_nocase(str, "resign")) {
+        return Board::RESIGN;
+    }
+
+    const int c = std::tolower(static_cast<unsigned char>(str[0]));
+    int y;
+    if (c < 'a' || c > 'z' || c == 'i' ||
+            !parse_int(str+1, y)) {
+        return Board::NULL_VERTEX;
+    }
+
+    int x = c - 'a';
+    if (x >= 8) x--; // skip I
+    y -= 1;
+
+    const int board_size = main_game->get_board_size();
+    if (x >= board_size || y < 0 || y >= board_size) {
+        return Board::NULL_VERTEX;
+    }
+    return main_game->get_vertex(x,y);
+}
+
+static bool syntax_error(GtpContext &ctx) {
+    ctx.response.assign("syntax not understood");
+    return false;
+}
+
+static bool shared_engine_error(GtpContext &ctx) {
+    ctx.response.assign("not available in server mode");
+    return false;
+}
+
+static bool too_many_moves(GtpContext &ctx) {
+    if (ctx.max_moves > 0 && ctx.main_game->get_movenum() >= ctx.max_moves) {
+        ctx.response.assign("too many moves");
+        return true;
+    }
+    return false;
+}
+
+static bool gtp_protocol_version(GtpContext &ctx) {
+    ctx.response.assign("2");
+    return true;
+}
+
+static bool gtp_name(GtpContext &ctx) {
+    ctx.response.assign("Go Bot");
+    return true;
+}
+
+static bool gtp_version(GtpContext &ctx) {
+    ctx.response.assign("0.1");
+    return true;
+}
+
+static bool gtp_quit(GtpContext &ctx) {
+    ctx.quit = true;
+    return true;
+}
+
+static bool gtp_boardsize(GtpContext &ctx) {
+    int bsize = -1;
+    if (ctx.command.argc >= 2 &&
+            parse_int(ctx.command.argv[1], bsize) &&
+            bsize >= 2 && bsize <= Board::BOARD_SIZE) {
+        float komi = ctx.main_game->get_komi();
+        ctx.main_game->clear_board(bsize, komi);
+        ctx.time_control->reset_clocks();
+        return true;
+    }
+    ctx.response.assign("unacceptable size");
+    return false;
+}
+
+static bool gtp_komi(GtpContext &ctx) {
+    float komi;
+    if (ctx.command.argc >= 2 && parse_float(ctx.command.argv[1], komi)) {
+        ctx.main_game->set_komi(komi);
+        return true;
+    }
+    return syntax_error(ctx);
+}
+
+static bool gtp_clear_board(GtpContext &ctx) {
+    int bsize = ctx.main_game->get_board_size();
+    float komi = ctx.main_game->get_komi();
+    ctx.main_game->clear_board(bsize, komi);
+    ctx.time_control->reset_clocks();
+    return true;
+}
+
+static bool gtp_undo(GtpContext &ctx) {
+    ctx.main_game->undo_move();
+    return true;
+}
+
+static bool gtp_play(GtpContext &ctx) {
+    if (ctx.command.argc < 3) {
+        return syntax_error(ctx);
+    }
+    const int color = parse_color(ctx.command.argv[1]);
+    const int vtx = parse_vertex(ctx.main_game, ctx.command.argv[2]);
+
+    if (color == Board::INVLD || vtx == Board::NULL_VERTEX) {
+        return syntax_error(ctx);
+    }
+    if (too_many_moves(ctx)) {
+        return false;
+    }
+    if (!ctx.main_game->play_move(vtx, color)) {
+        ctx.response.assign("illegal move");
+        return false;
+    }
+    return true;
+}
+
+static bool gtp_genmove(GtpContext &ctx) {
+    auto main_game = ctx.main_game;
+    auto time_control = ctx.time_control;
+
+    int color = main_game->get_tomove();
+    if (ctx.command.argc >= 2) {
+        color = parse_color(ctx.command.argv[1]);
+        if (color == Board::INVLD) {
+            return syntax_error(ctx);
+        }
+    }
+    if (too_many_moves(ctx)) {
+        return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const double thinking_time = time_control->get_thinking_time(
+                                     color, main_game->get_board_size(),
+                                     main_game->get_movenum());
+
+    int vtx = ctx.search->think(*main_game, color, thinking_time);
+    if (!main_game->play_move(vtx, color)) {
+        // Never answer a move which is not played, pass is always legal.
+        vtx = Board::PASS;
+        main_game->play_move(vtx, color);
+    }
+
+    time_control->consume(color, std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start).count());
+    ctx.ponder_pending = true;
+
+    ctx.response.append(main_game->vertex_to_text(vtx));
+    return true;
+}
+
+static bool gtp_loadsgf(GtpContext &ctx) {
+    int move_number = 0;
+    if (ctx.command.argc < 2 ||
+            (ctx.command.argc >= 3 && !parse_int(ctx.command.argv[2], move_number))) {
+        return syntax_error(ctx);
+    }
+
+    MappedFile file;
+    std::vector<SgfGame> games;
+    if (file.open(ctx.command.argv[1])) {
+        SgfParser::split_games(file.data(), file.size(), games);
+    }
+
+    // Load the position before the move number, or the whole game.
+    GameState state = *ctx.main_game;
+    if (games.empty() ||
+            SgfParser::load_game(file.data() + games[0].begin,
+                                     file.data() + games[0].end,
+                                     state, move_number > 0 ? move_number - 1 : -1) < 0) {
+        ctx.response.assign("cannot load file");
+        return false;
+    }
+    *ctx.main_game = state;
+    ctx.time_control->reset_clocks();
+    return true;
+}
+
+static bool gtp_time_settings(GtpContext &ctx) {
+    float main_time, byo_time;
+    int byo_stones;
+    if (ctx.command.argc < 4 ||
+            !parse_float(ctx.command.argv[1], main_time) ||
+            !parse_float(ctx.command.argv[2], byo_time) ||
+            !parse_int(ctx.command.argv[3], byo_stones)) {
+        return syntax_error(ctx);
+    }
+    ctx.time_control->set_canadian(main_time, byo_time, byo_stones);
+    if (byo_time > 0.f && byo_stones == 0) {
+        // No time limit in GTP.
+        ctx.time_control->set_no_limit();
+    }
+    return true;
+}
+
+static bool gtp_kgs_time_settings(GtpContext &ctx) {
+    const auto &cmd = ctx.command;
+    const char *system = cmd.get_arg(1);
+    float main_time, byo_time;
+    int byo_stones;
+
+    if (std::strcmp(system, "none") == 0) {
+        ctx.time_control->set_no_limit();
+    } else if (std::strcmp(system, "absolute") == 0 &&
+                   parse_float(cmd.get_arg(2), main_time)) {
+        ctx.time_control->set_canadian(main_time, 0.f, 0);
+    } else if ((std::strcmp(system, "byoyomi") == 0 ||
+                    std::strcmp(system, "canadian") == 0) &&
+                   parse_float(cmd.get_arg(2), main_time) &&
+                   parse_float(cmd.get_arg(3), byo_time) &&
+                   parse_int(cmd.get_arg(4), byo_stones)) {
+        if (system[0] == 'b') {
+            ctx.time_control->set_japanese(main_time, byo_time, byo_stones);
+        } else {
+            ctx.time_control->set_canadian(main_time, byo_time, byo_stones);
+        }
+    } else {
+        return syntax_error(ctx);
+    }
+    return true;
+}
+
+static bool gtp_time_left(GtpContext &ctx) {
+    const auto &cmd = ctx.command;
+    const int color = parse_color(cmd.get_arg(1));
+    float time;
+    int stones;
+
+    if (color == Board::INVLD ||
+            !parse_float(cmd.get_arg(2), time) ||
+            !parse_int(cmd.get_arg(3), stones)) {
+        return syntax_error(ctx);
+    }
+    ctx.time_control->time_left(color, time, stones);
+    return true;
+}
+
+static bool gtp_set_ponder(GtpContext &ctx) {
+    if (ctx.shared) {
+        return shared_engine_error(ctx);
+    }
+    const char *mode = ctx.command.get_arg(1);
+    if (std::strcmp(mode, "on") == 0) {
+        ctx.ponder_enabled = true;
+    } else if (std::strcmp(mode, "off") == 0) {
+        ctx.ponder_enabled = false;
+    } else {
+        return syntax_error(ctx);
+    }
+    return true;
+}
+
+static bool gtp_set_playout_policy(GtpContext &ctx) {
+    const char *policy = ctx.command.get_arg(1);
+    if (std::strcmp(policy, "uniform") == 0) {
+        ctx.main_game->set_playout_policy(GameState::UNIFORM_POLICY);
+    } else if (std::strcmp(policy, "pattern") == 0) {
+        ctx.main_game->set_playout_policy(GameState::PATTERN_POLICY);
+    } else {
+        return syntax_error(ctx);
+    }
+    return true;
+}
+
+static bool gtp_set_superko_rule(GtpContext &ctx) {
+    const char *rule = ctx.command.get_arg(1);
+    if (std::strcmp(rule, "none") == 0) {
+        ctx.main_game->set_superko_rule(GameState::NO_SUPERKO);
+    } else if (std::strcmp(rule, "positional") == 0) {
+        ctx.main_game->set_superko_rule(GameState::POSITIONAL_SUPERKO);
+    } else if (std::strcmp(rule, "situational") == 0) {
+        ctx.main_game->set_superko_rule(GameState::SITUATIONAL_SUPERKO);
+    } else {
+        return syntax_error(ctx);
+    }
+    return true;
+}
+
+static bool gtp_set_playouts(GtpContext &ctx) {
+    int playouts;
+    if (!parse_int(ctx.command.get_arg(1), playouts)) {
+        return syntax_error(ctx);
+    }
+    ctx.search->set_playouts(playouts);
+    return true;
+}
+
+static bool gtp_set_visits(GtpContext &ctx) {
+    int visits;
+    if (!parse_int(ctx.command.get_arg(1), visits)) {
+        return syntax_error(ctx);
+    }
+    ctx.search->set_visits(visits);
+    return true;
+}
+
+static bool gtp_set_thinking_time(GtpContext &ctx) {
+    float seconds;
+    if (!parse_float(ctx.command.get_arg(1), seconds)) {
+        return syntax_error(ctx);
+    }
+    ctx.search->set_time(seconds);
+    return true;
+}
+
+static bool gtp_set_threads(GtpContext &ctx) {
+    if (ctx.shared) {
+        return shared_engine_error(ctx);
+    }
+    int threads;
+    if (!parse_int(ctx.command.get_arg(1), threads)) {
+        return syntax_error(ctx);
+    }
+    ctx.search->set_threads(threads);
+    return true;
+}
+
+static bool gtp_set_tt_size(GtpContext &ctx) {
+    if (ctx.shared) {
+        return shared_engine_error(ctx);
+    }
+    int megabytes;
+    if (!parse_int(ctx.command.get_arg(1), megabytes)) {
+        return syntax_error(ctx);
+    }
+    ctx.search->set_tt_size(megabytes);
+    return true;
+}
+
+static bool gtp_perf_counters(GtpContext &ctx) {
+#ifdef ENABLE_PERF_COUNTERS
+    const char *mode = ctx.command.get_arg(1);
+    if (std::strcmp(mode, "reset") == 0) {
+        PerfCounters::reset();
+    } else if (mode[0] == '\0') {
+        ctx.response.append(PerfCounters::get_text());
+    } else {
+        return syntax_error(ctx);
+    }
+    return true;
+#else
+    ctx.response.assign("performance counters are not compiled in");
+    return false;
+#endif
+}
+
+static bool gtp_showboard(GtpContext &ctx) {
+    ctx.main_game->showboard();
+    return true;
+}
+
+static bool gtp_final_score(GtpContext &ctx) {
+    float score = ctx.main_game->final_score();
+
+    if (std::abs(score) < 0.001f) {
+        ctx.response.append("draw");
+    } else if (score > 0.f) {
+        ctx.response.append("b+");
+        append_float(ctx.response, score);
+    } else {
+        ctx.response.append("w+");
+        append_float(ctx.response, -score);
+    }
+    return true;
+}
+
+static bool gtp_list_commands(GtpContext &ctx);
+
+// The supported commands, sorted by name for the binary search.
+static const GtpHandler GTP_HANDLERS[] = {
+    // Part of GTP version 2 standard command
+    {"boardsize", gtp_boardsize, true},
+
+    // Part of GTP version 2 standard command
+    {"clear_board", gtp_clear_board, true},
 
-std::vector<std::string> GTP_COMMANDS_LIST = {
     // Part of GTP version 2 standard command
-    "protocol_version",
+    {"final_score", gtp_final_score, true},
 
     // Part of GTP version 2 standard command
-    "name",
+    {"genmove", gtp_genmove, true},
+
+    // Same as list_commands
+    {"help", gtp_list_commands, false},
+
+    // Extended command, set the KGS time settings
+    {"kgs-time_settings", gtp_kgs_time_settings, true},
 
     // Part of GTP version 2 standard command
-    "version",
+    {"komi", gtp_komi, true},
 
     // Part of GTP version 2 standard command
-    "quit",
+    {"list_commands", gtp_list_commands, true},
 
     // Part of GTP version 2 standard command
-    "list_commands",
+    {"loadsgf", gtp_loadsgf, true},
 
     // Part of GTP version 2 standard command
-    "boardsize",
+    {"name", gtp_name, true},
+
+    // Extended command, show the performance counters, or reset them
+    // with "reset"
+    {"perf_counters", gtp_perf_counters, true},
 
     // Part of GTP version 2 standard command
-    "clear_board",
+    {"play", gtp_play, true},
 
     // Part of GTP version 2 standard command
-    "komi",
+    {"protocol_version", gtp_protocol_version, true},
+
+    // Part of GTP version 2 standard command
+    {"quit", gtp_quit, true},
+
+    // Extended command, set the playout policy, uniform or pattern
+    {"set_playout_policy", gtp_set_playout_policy, true},
+
+    // Extended command, set the maximum playouts per move
+    {"set_playouts", gtp_set_playouts, true},
+
+    // Extended command, turn the pondering on or off
+    {"set_ponder", gtp_set_ponder, true},
+
+    // Extended command, set the superko rule, none, positional or
+    // situational
+    {"set_superko_rule", gtp_set_superko_rule, true},
+
+    // Extended command, set the maximum thinking time per move
+    {"set_thinking_time", gtp_set_thinking_time, true},
+
+    // Extended command, set the number of search threads
+    {"set_threads", gtp_set_threads, true},
+
+    // Extended command, set the transposition table size in megabytes
+    {"set_tt_size", gtp_set_tt_size, true},
+
+    // Extended command, set the maximum visits of root per move
+    {"set_visits", gtp_set_visits, true},
 
     // Part of GTP version 2 standard command
-    "play",
+    {"showboard", gtp_showboard, true},
 
     // Part of GTP version 2 standard command
-    "genmove",
+    {"time_left", gtp_time_left, true},
 
     // Part of GTP version 2 standard command
-    "showboard",
+    {"time_settings", gtp_time_settings, true},
 
     // Part of GTP version 2 standard command
-    "undo",
+    {"undo", gtp_undo, true},
 
     // Part of GTP version 2 standard command
-    "final_score"
+    {"version", gtp_version, true}
 };
 
-void gtp_prcoess(GameState *main_game);
-std::string gtp_success(std::string response);
-std::string gtp_fail(std::string response);
-void gtp_hint();
+static bool gtp_list_commands(GtpContext &ctx) {
+    // The table is already sorted, so build the list only once.
+    static const std::string list_commands = []() {
+        auto list = std::string{};
+        for (const auto &handler : GTP_HANDLERS) {
+            if (!handler.listed) continue;
+            if (!list.empty()) list += '\n';
+            list += handler.name;
+        }
+        return list;
+    }();
 
-void gtp_loop(bool hint) {
-    if (hint) gtp_hint();
+    ctx.response.append(list_commands);
+    return true;
+}
 
-    auto main_game = std::make_shared<GameState>();
-    main_game->clear_board(9, 7.f);
+static const GtpHandler *find_handler(const char *name) {
+    const auto begin = std::begin(GTP_HANDLERS);
+    const auto end = std::end(GTP_HANDLERS);
+    const auto it = std::lower_bound(begin, end, name,
+                        [](const GtpHandler &handler, const char *n) {
+                            return std::strcmp(handler.name, n) < 0;
+                        });
 
-    for (;;) {
-        gtp_prcoess(main_game.get());
+    if (it != end && std::strcmp(it->name, name) == 0) {
+        return it;
     }
+    return nullptr;
 }
 
-void gtp_prcoess(GameState *main_game) {
-    std::string inputs;
-    if (!std::getline(std::cin, inputs)) {
-        return;
+// Execute one input line and build the whole response in ctx.output.
+// Return false if the line has no command.
+static bool gtp_execute(GtpContext &ctx, const std::string &inputs) {
+    auto &cmd = ctx.command;
+    if (!cmd.parse(inputs)) {
+        return false;
     }
 
-    std::istringstream ss{inputs};
-    std::string buf;
-    std::vector<std::string> args;
+    ctx.response.clear();
 
-    while (ss >> buf) {
-        args.emplace_back(buf);
+    bool success = false;
+    const auto handler = find_handler(cmd.argv[0]);
+    if (handler) {
+        success = handler->func(ctx);
+    } else {
+        ctx.response.assign("unknown command");
     }
 
-    if (args.empty()) {
-        return;
+    auto &output = ctx.output;
+    output.clear();
+    output += success ? '=' : '?';
+    if (cmd.id >= 0) {
+        append_int(output, cmd.id);
     }
+    output += ' ';
+    output += ctx.response;
+    output += "\n\n";
 
-    // check the command id here
-    command_id = -1;
-    auto toke_str = args[0];
-    bool is_digit = true;
+    return true;
+}
 
-    for (char c : toke_str) {
-        is_digit &= isdigit(c);
-    }
-    if (is_digit) {
-        command_id = std::stoi(toke_str);
-        args.erase(std::begin(args)); // remove command id
+// Write the response with a single write.
+static void gtp_write(GtpContext &ctx, std::ostream &out) {
+    out.write(ctx.output.data(), ctx.output.size());
+    out.flush();
+}
+
+void gtp_hint();
+
+// Read the inputs on its own thread, so that the main thread could
+// ponder while waiting for the next command.
+void gtp_read_inputs() {
+    std::string inputs;
+    while (std::getline(std::cin, inputs)) {
+        std::lock_guard<std::mutex> lock(input_mutex);
+        input_queue.emplace_back(inputs);
+        input_cv.notify_one();
     }
 
-    const size_t argc = args.size();
-    const auto main_cmd = args[0];
+    // The end of inputs.
+    std::lock_guard<std::mutex> lock(input_mutex);
+    input_queue.emplace_back("quit");
+    input_cv.notify_one();
+}
 
-    if (argc == 0) {
-        return;
-    }
-
-    if (main_cmd == "quit") {
-        std::cout << gtp_success(std::string{});
-        exit(EXIT_SUCCESS);
-    } else if (main_cmd == "protocol_version") {
-        std::cout << gtp_success("2");
-    } else if (main_cmd == "name") {
-        std::cout << gtp_success("Go Bot");
-    } else if (main_cmd == "version") {
-        std::cout << gtp_success("0.1");
-    } else if (main_cmd == "boardsize") {
-        if (argc >= 2) {
-            int bsize = std::stoi(args[1]);
-            float komi = main_game->get_komi();
-            main_game->clear_board(bsize, komi);
-
-            std::cout << gtp_success(std::string{});
-        } else {
-            std::cout << gtp_fail(std::string{});
-        }
-    } else if (main_cmd == "komi") {
-        if (argc >= 2) {
-            float komi = std::stof(args[1]);
-            main_game->set_komi(komi);
+void gtp_loop(bool hint, int threads, bool ponder, BatchEvaluator *evaluator) {
+    if (hint) gtp_hint();
 
-            std::cout << gtp_success(std::string{});
-        } else {
-            std::cout << gtp_fail(std::string{});
-        }
-    } else if (main_cmd == "clear_board") {
-        int bsize = main_game->get_board_size();
-        float komi = main_game->get_komi();
-        main_game->clear_board(bsize, komi);
-
-        std::cout << gtp_success(std::string{});
-    }  else if (main_cmd == "undo") {
-        main_game->undo_move();
-        std::cout << gtp_success(std::string{});
-    } else if (main_cmd == "play") {
-        int color = Board::INVLD;
-        int vtx = Board::NULL_VERTEX;
-
-        if (argc >= 2) {
-            auto color_str = args[1];
-            if (std::tolower(color_str[0]) == 'b') {
-                color = Board::BLACK;
-            } else if (std::tolower(color_str[0]) == 'w') {
-                color = Board::WHITE;
-            }
-        }
+    auto main_game = std::make_shared<GameState>();
+    main_game->clear_board(9, 7.f);
 
-        if (argc >= 3) {
-            auto vtx_str = args[2];
-            for (char &v : vtx_str) {
-                v = std::tolower(v);
-            }
-            if (vtx_str == "pass") {
-                vtx = Board::PASS;
-            } else if (vtx_str == "resign") {
-                vtx = Board::RESIGN;
-            } else if (vtx_str.size() <= 3) {
-                char start = 'A'; // 65
-                if (vtx_str[0] >= 'a') {
-                    start = 'a'; // 97
-                }
-
-                int x = vtx_str[0] - start;
-                int y = std::stoi(vtx_str.substr(1)) - 1;
-                if (x >= 8) x--; // skip I
-
-                vtx = main_game->get_vertex(x,y);
-            }
-        }
+    auto search = std::make_shared<Search>();
+    search->set_threads(threads);
+    search->set_evaluator(evaluator);
 
-        if (color != Board::INVLD &&
-                vtx != Board::NULL_VERTEX &&
-                main_game->play_move(vtx, color)) {
-            std::cout << gtp_success(std::string{});
-        } else {
-            std::cout << gtp_fail(std::string{});
-        }
-    } else if (main_cmd == "genmove") {
-        // TODO: You should implement your move generator here.
-
-        int color = main_game->get_tomove();
-        if (argc >= 2) {
-            auto color_str = args[1];
-            if (std::tolower(color_str[0]) == 'b') {
-                color = Board::BLACK;
-            } else if (std::tolower(color_str[0]) == 'w') {
-                color = Board::WHITE;
-            }
-        }
-        int vtx = main_game->play_random_move(color);
-        std::string out;
-
-        if (vtx == Board::PASS) {
-            out = "pass";
-        } else if (vtx == Board::RESIGN) {
-            out = "resign";
-        } else if (vtx == Board::NULL_VERTEX) {
-            out = "null";
-        } else {
-            const char *x_lable_map = "ABCDEFGHJKLMNOPQRST";
-            int x = main_game->get_x(vtx);
-            int y = main_game->get_y(vtx);
-            out += x_lable_map[x];
-            out += std::to_string(y+1);
-        }
+    auto time_control = std::make_shared<TimeControl>();
+
+    GtpContext ctx;
+    ctx.main_game = main_game.get();
+    ctx.search = search.get();
+    ctx.time_control = time_control.get();
+
+    ctx.ponder_enabled = ponder;
 
-        std::cout << gtp_success(out);
-    } else if (main_cmd == "showboard") {
-        main_game->showboard();
-        std::cout << gtp_success(std::string{});
-    } else if (main_cmd == "final_score") {
-        float score = main_game->final_score();
-        std::ostringstream result;
-
-        if (std::abs(score) < 0.001f) {
-            result << "draw";
-        } else if (score > 0.f) {
-            result << "b+" << score;
-        } else if (score < 0.f) {
-            result << "w+" << -score;
+    std::thread(gtp_read_inputs).detach();
+
+    std::string inputs;
+    while (!ctx.quit) {
+        std::unique_lock<std::mutex> lock(input_mutex);
+
+        if (input_queue.empty() &&
+                ctx.ponder_enabled && ctx.ponder_pending &&
+                main_game->get_passes() < 2) {
+            lock.unlock();
+            search->start_ponder(*main_game);
+            lock.lock();
+
+            input_cv.wait(lock, []() { return !input_queue.empty(); });
+
+            lock.unlock();
+            search->stop_ponder();
+            lock.lock();
         }
-        std::cout << gtp_success(result.str());
-    } else if (main_cmd == "help" ||
-                   main_cmd == "list_commands") {
-        auto list_commands = std::ostringstream{};
-        auto idx = size_t{0};
+        input_cv.wait(lock, []() { return !input_queue.empty(); });
 
-        std::sort(std::begin(GTP_COMMANDS_LIST), std::end(GTP_COMMANDS_LIST));
+        inputs.swap(input_queue.front());
+        input_queue.pop_front();
+        lock.unlock();
 
-        for (const auto &cmd : GTP_COMMANDS_LIST) {
-            list_commands << cmd;
-            if (++idx != GTP_COMMANDS_LIST.size()) list_commands << std::endl;
+        ctx.ponder_pending = false;
+        if (gtp_execute(ctx, inputs)) {
+            gtp_write(ctx, std::cout);
         }
-        std::cout << gtp_success(list_commands.str());
-    } else {
-        std::cout << gtp_fail("unknown command");
     }
 }
 
-std::string gtp_success(std::string response) {
-    auto out = std::ostringstream{};
+int gtp_run(std::istream &in, std::ostream &out, GameState *main_game,
+                Search *search, TimeControl *time_control) {
+    GtpContext ctx;
+    ctx.main_game = main_game;
+    ctx.search = search;
+    ctx.time_control = time_control;
 
-    if (command_id >= 0) {
-        out << '=' << command_id << ' ' << response << "\n\n";
-    } else {
-        out << '='               << ' ' << response << "\n\n";
+    int commands = 0;
+    std::string inputs;
+    while (!ctx.quit && std::getline(in, inputs)) {
+        if (gtp_execute(ctx, inputs)) {
+            gtp_write(ctx, out);
+            commands++;
+        }
     }
+    return commands;
+}
 
-    return out.str();
+GtpSession::GtpSession(int max_moves)
+    : m_game(new GameState),
+      m_time_control(new TimeControl),
+      m_ctx(new GtpContext) {
+    m_game->clear_board(std::min(9, Board::BOARD_SIZE), 7.f);
+
+    m_ctx->main_game = m_game.get();
+    m_ctx->search = nullptr;
+    m_ctx->time_control = m_time_control.get();
+    m_ctx->shared = true;
+    m_ctx->max_moves = max_moves;
+
+    m_playouts = 0;
+    m_visits = 0;
+    m_time = 0.0;
 }
 
-std::string gtp_fail(std::string response) {
-    auto out = std::ostringstream{};
+GtpSession::~GtpSession() = default;
+
+const std::string *GtpSession::execute(const std::string &inputs, Search *search) {
+    // The search limits belong to the session.
+    search->set_playouts(m_playouts);
+    search->set_visits(m_visits);
+    search->set_time(m_time);
+    m_ctx->search = search;
 
-    out << "? " << response << "\n\n";
+    const bool executed = gtp_execute(*m_ctx, inputs);
+
+    m_ctx->search = nullptr;
+    m_playouts = search->get_playouts();
+    m_visits = search->get_visits();
+    m_time = search->get_time();
+
+    return executed ? &m_ctx->output : nullptr;
+}
 
-    return out.str();
+bool GtpSession::is_quit() const {
+    return m_ctx->quit;
 }
 
 void gtp_hint() {
@@ -278,7 +847,9 @@ void gtp_hint() {
         << "Enter \"showboard\"     to show the current board state.\n"
         << "Enter \"play b d6\"     to place the black stone on the board at the E6.\n"
         << "Enter \"play w f4\"     to place the white stone on the board at the F4.\n"
-        << "Enter \"genmove b\"     to genrate a random move and play it.\n"
+        << "Enter \"genmove b\"     to search a move with MCTS and play it.\n"
+        << "Enter \"set_playouts 1600\" to set the playouts per move.\n"
+        << "Enter \"time_settings 300 30 5\" to set 5 minutes main time and 5 moves per 30 seconds.\n"
         << "Enter \"clear_board\"   to create a new game.\n"
         << "Enter \"komi 7.5\"      to set the komi as 7.5.\n"
         << "Enter \"boardsize 13\"  to set the board size as 13 and create a new game.\n"
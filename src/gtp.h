@@ -1,6 +1,58 @@
 #ifndef GTP_H_INCLUDE
 #define GTP_H_INCLUDE
 
-void gtp_loop(bool hint);
+#include <iostream>
+#include <memory>
+#include <string>
+
+class GameState;
+class Search;
+class TimeControl;
+class BatchEvaluator;
+struct GtpContext;
+
+// Run the GTP loop. The search uses the given number of threads. If
+// ponder is true, it searches while the opponent is thinking. If the
+// evaluator is given, the search uses the network value.
+void gtp_loop(bool hint, int threads, bool ponder,
+                  BatchEvaluator *evaluator = nullptr);
+
+// Execute the GTP commands read from in and write the responses to
+// out, until the end of inputs or quit. It does not ponder. Return the
+// number of executed commands.
+int gtp_run(std::istream &in, std::ostream &out, GameState *main_game,
+                Search *search, TimeControl *time_control);
+
+// The state of one GTP client, its game, clock, search limits and parser
+// buffers. The search is given per command, so many sessions could share
+// a few searches. The commands which change the shared engine, like
+// set_threads, are not available.
+class GtpSession {
+public:
+    // The game is limited to max_moves moves, zero means no limit.
+    explicit GtpSession(int max_moves = 0);
+    ~GtpSession();
+
+    // Execute one input line with the search. Return the response, or
+    // nullptr if the line has no command. The response is valid until
+    // the next call.
+    const std::string *execute(const std::string &inputs, Search *search);
+
+    // Return true after the quit command.
+    bool is_quit() const;
+
+private:
+    std::unique_ptr<GameState> m_game;
+
+    std::unique_ptr<TimeControl> m_time_control;
+
+    std::unique_ptr<GtpContext> m_ctx;
+
+    int m_playouts;
+
+    int m_visits;
+
+    double m_time;
+};
 
 #endif
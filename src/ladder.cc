@@ -0,0 +1,272 @@
+#include "ladder.h"
+
+#include <algorithm>
+
+constexpr int Ladder::DEFAULT_MAX_NODES;
+
+// The most moves tried to save one string. More are very rare, the rest
+// are skipped.
+static constexpr int MAX_CANDIDATES = 16;
+
+static bool defender_dies(Board &board, int vtx, int &nodes);
+static bool attacker_wins(Board &board, int vtx, int &nodes);
+
+// Collect the moves which may save the string in atari, its liberty and
+// the captures of the opponent strings in atari next to it.
+static int get_escape_candidates(const Board &board, int vtx, int *moves) {
+    const int color = board.get_state(vtx);
+    int cnt = 0;
+    moves[cnt++] = board.get_atari_liberty(vtx);
+
+    auto adjacent = board.get_string_bitboard(vtx).dilate(board.get_shift()) &
+                        board.get_bitboard(!color);
+    for (int pos = adjacent.first(); pos >= 0 && cnt < MAX_CANDIDATES; pos = adjacent.first()) {
+        const int lib = board.get_atari_liberty(pos);
+        if (lib != Board::NULL_VERTEX &&
+                std::find(moves, moves + cnt, lib) == moves + cnt) {
+            moves[cnt++] = lib;
+        }
+        adjacent = adjacent - board.get_string_bitboard(pos);
+    }
+    return cnt;
+}
+
+// Return true if the string, which is in atari after the move, escapes.
+// The string has three liberties or the opponent can not catch it.
+static bool escapes(Board &board, int vtx, int &nodes) {
+    const int libs = board.get_liberties(vtx);
+    return libs >= 3 || (libs == 2 && !attacker_wins(board, vtx, nodes));
+}
+
+// The owner of the string in atari is to move.
+static bool defender_dies(Board &board, int vtx, int &nodes) {
+    const int color = board.get_state(vtx);
+
+    int moves[MAX_CANDIDATES];
+    const int cnt = get_escape_candidates(board, vtx, moves);
+    for (int i = 0; i < cnt; ++i) {
+        const int move = moves[i];
+        if (!board.legal_move(move, color)) {
+            continue;
+        }
+        if (--nodes < 0) {
+            // Out of the budget, count it as escaped.
+            return false;
+        }
+        board.play_move_assume_legal(move, color);
+        const bool escaped = escapes(board, vtx, nodes);
+        board.undo_move();
+
+        if (escaped) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The opponent of the string with two liberties is to move.
+static bool attacker_wins(Board &board, int vtx, int &nodes) {
+    const int color = !board.get_state(vtx);
+
+    auto libs = board.get_liberty_set(vtx);
+    for (int lib = libs.first(); lib >= 0; lib = libs.first()) {
+        libs.reset(lib);
+        if (!board.legal_move(lib, color)) {
+            continue;
+        }
+        if (--nodes < 0) {
+            return false;
+        }
+        board.play_move_assume_legal(lib, color);
+        const bool captured = board.is_atari(vtx) &&
+                                  defender_dies(board, vtx, nodes);
+        board.undo_move();
+
+        if (captured) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Ladder::is_captured(Board &board, int vtx, int max_nodes) {
+    if (!board.is_atari(vtx)) {
+        return false;
+    }
+    int nodes = max_nodes;
+    return defender_dies(board, vtx, nodes);
+}
+
+bool Ladder::is_capturable(Board &board, int vtx, int max_nodes) {
+    if (board.get_liberties(vtx) != 2) {
+        return false;
+    }
+    int nodes = max_nodes;
+    return attacker_wins(board, vtx, nodes);
+}
+
+bool Ladder::is_escape_move(Board &board, int vtx, int color, int max_nodes) {
+    if (board.get_state(vtx) != Board::EMPTY) {
+        return false;
+    }
+
+    // Our strings in atari next to the move, or next to the opponent
+    // strings which the move captures.
+    int strings[MAX_CANDIDATES];
+    int cnt = 0;
+    Board::bitboard_t marked;
+    auto add_string = [&](int pos) {
+        if (cnt < MAX_CANDIDATES && !marked.test(pos)) {
+            strings[cnt++] = pos;
+            marked |= board.get_string_bitboard(pos);
+        }
+    };
+
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + board.get_direction(k);
+        const int state = board.get_state(avtx);
+        if (state == color && board.is_atari(avtx)) {
+            add_string(avtx);
+        } else if (state == !color && board.is_atari(avtx)) {
+            auto adjacent = board.get_string_bitboard(avtx).dilate(board.get_shift()) &
+                                board.get_bitboard(color);
+            for (int pos = adjacent.first(); pos >= 0; pos = adjacent.first()) {
+                adjacent.reset(pos);
+                if (board.is_atari(pos)) {
+                    add_string(pos);
+                }
+            }
+        }
+    }
+    if (cnt == 0 || !board.legal_move(vtx, color)) {
+        return false;
+    }
+
+    int nodes = max_nodes;
+    board.play_move_assume_legal(vtx, color);
+    bool escaped = true;
+    for (int i = 0; i < cnt && escaped; ++i) {
+        escaped = escapes(board, strings[i], nodes);
+    }
+    board.undo_move();
+
+    return escaped;
+}
+
+bool Ladder::is_capture_move(Board &board, int vtx, int color, int max_nodes) {
+    if (board.get_state(vtx) != Board::EMPTY ||
+            !board.legal_move(vtx, color)) {
+        return false;
+    }
+
+    // Only the opponent strings which had two liberties are in a new
+    // atari.
+    bool twos[4];
+    for (int k = 0; k < 4; ++k) {
+        const int avtx = vtx + board.get_direction(k);
+        twos[k] = board.get_state(avtx) == !color &&
+                      board.get_liberties(avtx) == 2;
+    }
+
+    int nodes = max_nodes;
+    board.play_move_assume_legal(vtx, color);
+    bool captured = false;
+    for (int k = 0; k < 4 && !captured; ++k) {
+        const int avtx = vtx + board.get_direction(k);
+        captured = twos[k] &&
+                       board.is_atari(avtx) &&
+                       defender_dies(board, avtx, nodes);
+    }
+    board.undo_move();
+
+    return captured;
+}
+
+void Ladder::remove_failed_escapes(Board &board, int color, std::vector<int> &moves,
+                                       int max_nodes) {
+    moves.erase(
+        std::remove_if(std::begin(moves), std::end(moves),
+                       [&](int vtx) {
+                           if (vtx < 0 || vtx >= Board::NUM_VERTICES) {
+                               return false;
+                           }
+                           bool extends = false;
+                           for (int k = 0; k < 4; ++k) {
+                               const int avtx = vtx + board.get_direction(k);
+                               const int state = board.get_state(avtx);
+                               if (state == !color && board.is_atari(avtx)) {
+                                   return false;
+                               }
+                               extends |= state == color && board.is_atari(avtx);
+                           }
+                           return extends &&
+                                      !is_escape_move(board, vtx, color, max_nodes);
+                       }),
+        std::end(moves));
+}
+
+int Ladder::get_planes_size(int board_size) {
+    return NUM_PLANES * board_size * board_size;
+}
+
+void Ladder::encode(const Board &board, float *planes, int max_nodes) {
+    const int board_size = board.get_board_size();
+    const int num_intersections = board_size * board_size;
+    const int tomove = board.get_tomove();
+
+    std::fill(planes, planes + get_planes_size(board_size), 0.f);
+
+    auto set_point = [&](int plane, int vtx) {
+        const int idx = board.get_index(board.get_x(vtx), board.get_y(vtx));
+        planes[plane * num_intersections + idx] = 1.f;
+    };
+    auto set_string = [&](int plane, Board::bitboard_t stones) {
+        for (int pos = stones.first(); pos >= 0; pos = stones.first()) {
+            stones.reset(pos);
+            set_point(plane, pos);
+        }
+    };
+
+    // Read on a copy, so the board is const. The journal of the game is
+    // not needed.
+    Board ladder_board;
+    ladder_board.copy_position(board);
+    Board::bitboard_t visited;
+
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        const int vtx = board.get_vertex(idx % board_size, idx / board_size);
+        const int state = board.get_state(vtx);
+        if ((state != Board::BLACK && state != Board::WHITE) || visited.test(vtx)) {
+            continue;
+        }
+        const auto stones = board.get_string_bitboard(vtx);
+        visited |= stones;
+
+        const int libs = board.get_liberties(vtx);
+        if (state == tomove && libs == 1) {
+            if (is_captured(ladder_board, vtx, max_nodes)) {
+                set_string(OWN_CAPTURED, stones);
+            }
+            int moves[MAX_CANDIDATES];
+            const int cnt = get_escape_candidates(board, vtx, moves);
+            for (int i = 0; i < cnt; ++i) {
+                if (is_escape_move(ladder_board, moves[i], tomove, max_nodes)) {
+                    set_point(ESCAPE_MOVES, moves[i]);
+                }
+            }
+        } else if (state == !tomove && libs == 2) {
+            if (!is_capturable(ladder_board, vtx, max_nodes)) {
+                continue;
+            }
+            set_string(OPPONENT_CAPTURABLE, stones);
+
+            auto liberties = board.get_liberty_set(vtx);
+            for (int lib = liberties.first(); lib >= 0; lib = liberties.first()) {
+                liberties.reset(lib);
+                if (is_capture_move(ladder_board, lib, tomove, max_nodes)) {
+                    set_point(CAPTURE_MOVES, lib);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef LADDER_H_INCLUDE
+#define LADDER_H_INCLUDE
+
+#include <vector>
+
+#include "board.h"
+
+// The ladder reader. It plays the chasing and escaping moves on the
+// board and takes them back by Board::undo_move(), so a read copies
+// nothing and the board is the same after the call. Every read stops
+// after the node limit, and then the string counts as escaped.
+class Ladder {
+public:
+    static constexpr int DEFAULT_MAX_NODES = 1000;
+
+    enum plane_t {
+        // Our strings in atari which can not escape.
+        OWN_CAPTURED = 0,
+
+        // The opponent strings with two liberties which we capture by
+        // ladder.
+        OPPONENT_CAPTURABLE = 1,
+
+        // The moves which save our strings in atari.
+        ESCAPE_MOVES = 2,
+
+        // The moves which start a working ladder.
+        CAPTURE_MOVES = 3,
+
+        NUM_PLANES = 4
+    };
+
+    // Return true if the string at the vertex, which has one liberty, is
+    // captured when its owner is to move.
+    static bool is_captured(Board &board, int vtx,
+                                int max_nodes = DEFAULT_MAX_NODES);
+
+    // Return true if the string at the vertex, which has two liberties,
+    // is captured by ladder when its opponent is to move.
+    static bool is_capturable(Board &board, int vtx,
+                                  int max_nodes = DEFAULT_MAX_NODES);
+
+    // Return true if the move of the color saves its string in atari
+    // next to it. Return false if there is no such string.
+    static bool is_escape_move(Board &board, int vtx, int color,
+                                   int max_nodes = DEFAULT_MAX_NODES);
+
+    // Return true if the move of the color puts an opponent string next
+    // to it in atari and captures it by ladder.
+    static bool is_capture_move(Board &board, int vtx, int color,
+                                    int max_nodes = DEFAULT_MAX_NODES);
+
+    // Remove the moves which extend our string in atari but fail to
+    // escape the ladder. They only lose more stones. The moves which
+    // capture are kept.
+    static void remove_failed_escapes(Board &board, int color, std::vector<int> &moves,
+                                          int max_nodes = DEFAULT_MAX_NODES);
+
+    // Get the number of floats of the planes.
+    static int get_planes_size(int board_size);
+
+    // Fill the ladder planes from the view of the side to move, in
+    // [plane][point] order like Features::encode(). Every string is read
+    // once.
+    static void encode(const Board &board, float *planes,
+                           int max_nodes = DEFAULT_MAX_NODES);
+};
+
+#endif
@@ -1,8 +1,268 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+
 #include "gtp.h"
+#include "zobrist.h"
+#include "symmetry.h"
+#include "pattern.h"
+#include "benchmark.h"
+#include "sgf.h"
+#include "selfplay.h"
+#include "record.h"
+#include "server.h"
+#include "evaluator.h"
+#include "cpu_backend.h"
+#include "perf_counters.h"
+
+// Replay all games of the SGF file and print the speed.
+static int replay_sgf(const std::string &filename, int threads) {
+    SgfReplayStats stats;
+    if (!sgf_replay_file(filename, threads, stats)) {
+        std::cerr << "cannot open " << filename << std::endl;
+        return 1;
+    }
+    std::cout << "replayed " << stats.games << " games ("
+                  << stats.failed << " failed), "
+                  << stats.moves << " moves in " << stats.seconds << " sec, "
+                  << static_cast<int>(stats.games / stats.seconds) << " games/sec"
+                  << std::endl;
+    return 0;
+}
+
+// Convert the SGF file to the binary record file.
+static int convert_sgf(const std::string &sgf_filename,
+                           const std::string &record_filename, int threads) {
+    SgfReplayStats stats;
+    if (!convert_sgf_to_record(sgf_filename, record_filename, threads, stats)) {
+        std::cerr << "cannot convert " << sgf_filename << std::endl;
+        return 1;
+    }
+    std::cout << "converted " << stats.games << " games ("
+                  << stats.failed << " failed), "
+                  << stats.moves << " moves in " << stats.seconds << " sec"
+                  << std::endl;
+    return 0;
+}
+
+// Play the self-play games and write them to the file, or stdout if the
+// file name is empty.
+static int selfplay(SelfPlay &selfplay, const std::string &filename) {
+    std::ofstream file;
+    if (!filename.empty()) {
+        file.open(filename);
+        if (!file) {
+            std::cerr << "cannot open " << filename << std::endl;
+            return 1;
+        }
+    }
+
+    const int games = selfplay.run(filename.empty() ? std::cout : file);
+    const double elapsed = selfplay.get_last_elapsed();
+    std::cerr << "played " << games << " games, "
+                  << selfplay.get_last_moves() << " moves in " << elapsed << " sec, "
+                  << games / elapsed << " games/sec"
+                  << std::endl;
+    return 0;
+}
+
+// Convert the text weights to the binary weights.
+static int convert_weights(const std::string &text_filename,
+                               const std::string &binary_filename) {
+    CpuBackend backend;
+    if (!backend.load_weights(text_filename)) {
+        std::cerr << "cannot load " << text_filename << std::endl;
+        return 1;
+    }
+    if (!backend.save_weights(binary_filename)) {
+        std::cerr << "cannot write " << binary_filename << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Create the network evaluator of the weights file. The name "random"
+// uses a small random network and "stub" the test backend. Return null if
+// the file could not be loaded.
+static std::unique_ptr<BatchEvaluator> make_evaluator(const std::string &weights,
+                                                          int batch_size, int timeout_us,
+                                                          int cache_mb, bool cache_symmetry) {
+    std::unique_ptr<NetworkBackend> backend;
+    if (weights == "stub") {
+        backend.reset(new StubBackend);
+    } else {
+        auto cpu_backend = std::unique_ptr<CpuBackend>(new CpuBackend);
+        if (weights == "random") {
+            cpu_backend->init_random(32, 4, 0);
+        } else if (!cpu_backend->load_weights(weights)) {
+            return nullptr;
+        }
+        backend = std::move(cpu_backend);
+    }
+    auto evaluator = std::unique_ptr<BatchEvaluator>(
+                         new BatchEvaluator(std::move(backend), batch_size, timeout_us));
+    if (cache_mb > 0) {
+        auto cache = std::make_shared<EvalCache>();
+        cache->resize(cache_mb);
+        cache->set_symmetry(cache_symmetry);
+        evaluator->set_cache(cache);
+    }
+    return evaluator;
+}
 
 int main(int argc, char ** argv) {
+    Zobrist::initialize();
+    Symmetry::initialize();
+    Pattern::initialize();
+
+    bool benchmark = false;
+    std::string benchmark_name = "all";
+    int perft_depth = 0;
+    bool ponder = false;
+    std::string replay_file;
+    std::string output_file;
+    std::string convert_files[2];
+    std::string convert_weights_files[2];
+    bool server = false;
+    std::string server_socket;
+    int max_sessions = 256;
+    int selfplay_games = 0;
+    SelfPlay selfplay_config;
+    int threads = 1;
+    std::string weights_file;
+    int batch_size = 8;
+    int batch_timeout_us = 200;
+    int cache_mb = 64;
+    bool cache_symmetry = false;
+    double perf_dump_seconds = 0.0;
+
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = std::string(argv[i]);
+
+        if (arg == "--benchmark") {
+            benchmark = true;
+        } else if (arg == "--benchmark-suite" && i+1 < argc) {
+            benchmark = true;
+            benchmark_name = argv[++i];
+        } else if (arg == "--perft" && i+1 < argc) {
+            perft_depth = std::stoi(argv[++i]);
+        } else if (arg == "--ponder") {
+            ponder = true;
+        } else if (arg == "--replay-sgf" && i+1 < argc) {
+            replay_file = argv[++i];
+        } else if (arg == "--convert-sgf" && i+2 < argc) {
+            convert_files[0] = argv[++i];
+            convert_files[1] = argv[++i];
+        } else if (arg == "--convert-weights" && i+2 < argc) {
+            convert_weights_files[0] = argv[++i];
+            convert_weights_files[1] = argv[++i];
+        } else if (arg == "--server") {
+            server = true;
+        } else if (arg == "--server-socket" && i+1 < argc) {
+            server = true;
+            server_socket = argv[++i];
+        } else if (arg == "--sessions" && i+1 < argc) {
+            max_sessions = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && i+1 < argc) {
+            threads = std::stoi(argv[++i]);
+        } else if (arg == "--selfplay" && i+1 < argc) {
+            selfplay_games = std::stoi(argv[++i]);
+        } else if (arg == "--generator" && i+1 < argc) {
+            if (!selfplay_config.set_generator(argv[++i])) {
+                std::cerr << "unknown generator " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--playouts" && i+1 < argc) {
+            selfplay_config.set_playouts(std::stoi(argv[++i]));
+        } else if (arg == "--boardsize" && i+1 < argc) {
+            selfplay_config.set_board_size(std::stoi(argv[++i]));
+        } else if (arg == "--komi" && i+1 < argc) {
+            selfplay_config.set_komi(std::stof(argv[++i]));
+        } else if (arg == "--output" && i+1 < argc) {
+            output_file = argv[++i];
+        } else if (arg == "--weights" && i+1 < argc) {
+            weights_file = argv[++i];
+        } else if (arg == "--batch-size" && i+1 < argc) {
+            batch_size = std::stoi(argv[++i]);
+        } else if (arg == "--batch-timeout-us" && i+1 < argc) {
+            batch_timeout_us = std::stoi(argv[++i]);
+        } else if (arg == "--cache-size" && i+1 < argc) {
+            cache_mb = std::stoi(argv[++i]);
+        } else if (arg == "--cache-symmetry") {
+            cache_symmetry = true;
+        } else if (arg == "--perf-dump" && i+1 < argc) {
+            perf_dump_seconds = std::stod(argv[++i]);
+        }
+    }
+
+    if (perf_dump_seconds > 0.0) {
+#ifdef ENABLE_PERF_COUNTERS
+        PerfCounters::start_dump(perf_dump_seconds);
+#else
+        std::cerr << "performance counters are not compiled in" << std::endl;
+#endif
+    }
+
+    if (perft_depth > 0) {
+        return benchmark_perft(perft_depth) ? 0 : 1;
+    }
+
+    if (benchmark) {
+        if (!benchmark_suite(benchmark_name)) {
+            std::cerr << "unknown benchmark " << benchmark_name << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!convert_weights_files[0].empty()) {
+        return convert_weights(convert_weights_files[0], convert_weights_files[1]);
+    }
+
+    std::unique_ptr<BatchEvaluator> evaluator;
+    if (!weights_file.empty()) {
+        evaluator = make_evaluator(weights_file, batch_size, batch_timeout_us,
+                                       cache_mb, cache_symmetry);
+        if (!evaluator) {
+            std::cerr << "cannot load " << weights_file << std::endl;
+            return 1;
+        }
+    }
+
+    if (selfplay_games > 0) {
+        selfplay_config.set_games(selfplay_games);
+        selfplay_config.set_threads(threads);
+        selfplay_config.set_evaluator(evaluator.get());
+        const int result = selfplay(selfplay_config, output_file);
+
+        const auto cache = evaluator ? evaluator->get_cache() : nullptr;
+        if (cache) {
+            std::cerr << "eval cache: " << cache->get_hits() << " hits of "
+                          << cache->get_probes() << " probes" << std::endl;
+        }
+        return result;
+    }
+
+    if (server) {
+        GtpServer gtp_server(threads, max_sessions, evaluator.get());
+        if (server_socket.empty()) {
+            gtp_server.serve_stdin();
+        } else if (!gtp_server.serve_socket(server_socket)) {
+            std::cerr << "cannot listen on " << server_socket << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!convert_files[0].empty()) {
+        return convert_sgf(convert_files[0], convert_files[1], threads);
+    }
+
+    if (!replay_file.empty()) {
+        return replay_sgf(replay_file, threads);
+    }
 
-    gtp_loop(true);
+    gtp_loop(true, threads, ponder, evaluator.get());
 
     return 0;
 }
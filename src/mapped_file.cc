@@ -0,0 +1,73 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &filename, bool sequential) {
+    close();
+
+#ifndef _WIN32
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        const auto size = static_cast<std::size_t>(st.st_size);
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            m_data = static_cast<const char *>(addr);
+            m_size = size;
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+
+    if (m_mapped) {
+        return true;
+    }
+#endif
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    m_buffer.assign(std::istreambuf_iterator<char>(file),
+                        std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (m_mapped) {
+        munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+    m_buffer.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+
+const char *MappedFile::data() const {
+    return m_data;
+}
+
+std::size_t MappedFile::size() const {
+    return m_size;
+}
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H_INCLUDE
+#define MAPPED_FILE_H_INCLUDE
+
+#include <cstddef>
+#include <string>
+
+// A read-only view of a whole file. It is memory-mapped if the system
+// supports it, otherwise the file is read into the memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Return true if the file is opened. If sequential is true, the
+    // system reads ahead for the forward scan.
+    bool open(const std::string &filename, bool sequential = false);
+
+    void close();
+
+    const char *data() const;
+
+    std::size_t size() const;
+
+private:
+    const char *m_data{nullptr};
+    std::size_t m_size{0};
+    bool m_mapped{false};
+
+    // The file contents if it is not mapped.
+    std::string m_buffer;
+};
+
+#endif
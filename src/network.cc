@@ -0,0 +1,68 @@
+#include "network.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+int Features::get_input_size(int board_size) {
+    return INPUT_CHANNELS * board_size * board_size;
+}
+
+void Features::encode(const Board &board, float *planes) {
+    const int board_size = board.get_board_size();
+    const int num_intersections = board_size * board_size;
+    const int tomove = board.get_tomove();
+
+    std::fill(planes, planes + get_input_size(board_size), 0.f);
+
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        const int vtx = board.get_vertex(idx % board_size, idx / board_size);
+        const int state = board.get_state(vtx);
+
+        if (state == tomove) {
+            planes[OWN_STONES * num_intersections + idx] = 1.f;
+        } else if (state == Board::EMPTY) {
+            planes[EMPTY_POINTS * num_intersections + idx] = 1.f;
+        } else {
+            planes[OPPONENT_STONES * num_intersections + idx] = 1.f;
+        }
+        if (tomove == Board::BLACK) {
+            planes[BLACK_TO_MOVE * num_intersections + idx] = 1.f;
+        }
+        planes[ONES * num_intersections + idx] = 1.f;
+    }
+
+    const int komove = board.get_komove();
+    if (komove != Board::NULL_VERTEX) {
+        planes[KO_MOVE * num_intersections +
+                   board.get_index(board.get_x(komove), board.get_y(komove))] = 1.f;
+    }
+
+    const int last_move = board.get_last_move();
+    if (last_move != Board::NULL_VERTEX && last_move != Board::PASS) {
+        planes[LAST_MOVE * num_intersections +
+                   board.get_index(board.get_x(last_move), board.get_y(last_move))] = 1.f;
+    }
+}
+
+StubBackend::StubBackend(int latency_us) {
+    m_latency_us = std::max(latency_us, 0);
+}
+
+void StubBackend::forward(int board_size, int batch_size,
+                              const float *, NetResult *results) {
+    if (m_latency_us > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(m_latency_us));
+    }
+
+    const int num_moves = board_size * board_size + 1;
+    for (int b = 0; b < batch_size; ++b) {
+        std::fill(std::begin(results[b].policy),
+                      std::begin(results[b].policy) + num_moves, 1.f / num_moves);
+        results[b].value = 0.f;
+    }
+}
+
+std::string StubBackend::get_name() const {
+    return "stub";
+}
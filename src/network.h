@@ -0,0 +1,72 @@
+#ifndef NETWORK_H_INCLUDE
+#define NETWORK_H_INCLUDE
+
+#include <array>
+#include <string>
+
+#include "board.h"
+
+// The input planes of the network, from the view of the side to move.
+// Each plane has board_size * board_size floats, indexed like
+// Board::get_index().
+class Features {
+public:
+    enum plane_t {
+        OWN_STONES = 0,
+        OPPONENT_STONES = 1,
+        EMPTY_POINTS = 2,
+        KO_MOVE = 3,
+        LAST_MOVE = 4,
+        BLACK_TO_MOVE = 5,
+        ONES = 6,
+        INPUT_CHANNELS = 7
+    };
+
+    // The number of floats of one position.
+    static int get_input_size(int board_size);
+
+    // Fill the planes of the board.
+    static void encode(const Board &board, float *planes);
+};
+
+// The outputs of the network for one position.
+struct NetResult {
+    // The move probabilities, indexed like Board::get_index(). The pass
+    // is at board_size * board_size.
+    std::array<float, Board::NUM_INTESECTIONS+1> policy;
+
+    // The expected result from the view of the side to move, from -1
+    // (loss) to 1 (win).
+    float value;
+};
+
+// The backend computes the network outputs of a batch. The evaluator
+// calls it from one thread only.
+class NetworkBackend {
+public:
+    virtual ~NetworkBackend() = default;
+
+    // Evaluate batch_size positions. The inputs are the planes of every
+    // position, one after another.
+    virtual void forward(int board_size, int batch_size,
+                             const float *inputs, NetResult *results) = 0;
+
+    virtual std::string get_name() const = 0;
+};
+
+// The test backend. It returns the uniform policy and the even value,
+// after waiting the latency per batch to look like a real device.
+class StubBackend : public NetworkBackend {
+public:
+    explicit StubBackend(int latency_us = 0);
+
+    void forward(int board_size, int batch_size,
+                     const float *inputs, NetResult *results) override;
+
+    std::string get_name() const override;
+
+private:
+    int m_latency_us;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "pattern.h"
+
+#include <algorithm>
+
+constexpr int Pattern::NUM_PATTERNS;
+constexpr int Pattern::NUM_NEIGHBORS;
+constexpr int Pattern::SHAPE_WEIGHT;
+
+std::array<std::uint32_t, Pattern::NUM_PATTERNS> Pattern::WEIGHTS;
+
+// The weights of the shapes. The plain point next to any stone is 100.
+// The strong biases make the playouts worse judges of the position, so
+// the shapes only get a mild bonus here. Pattern::SHAPE_WEIGHT picks the
+// good shapes next to the last move.
+static constexpr int EMPTY_AREA_WEIGHT = 100;
+static constexpr int FIRST_LINE_WEIGHT = 60;
+static constexpr int DIAGONAL_WEIGHT = 100;
+static constexpr int CONTACT_WEIGHT = 150;
+static constexpr int HANE_WEIGHT = 200;
+static constexpr int CUT_WEIGHT = 250;
+static constexpr int CONNECT_WEIGHT = 200;
+static constexpr int EMPTY_TRIANGLE_WEIGHT = 50;
+static constexpr int FILL_WEIGHT = 30;
+
+// The diagonal between two adjacent directions, so the directions k1
+// and k2 and the diagonal make a 2x2 square with the point.
+static constexpr int CORNERS[4][3] = {
+    {0, 1, 4},  // up, left, up-left
+    {0, 2, 5},  // up, right, up-right
+    {3, 1, 6},  // down, left, down-left
+    {3, 2, 7}   // down, right, down-right
+};
+
+void Pattern::initialize() {
+    for (int code = 0; code < NUM_PATTERNS; ++code) {
+        WEIGHTS[code] = compute_weight(code, Board::BLACK) |
+                            (compute_weight(code, Board::WHITE) << 16);
+    }
+}
+
+int Pattern::get_state(std::uint16_t code, int k) {
+    return (code >> (2 * k)) & 3;
+}
+
+int Pattern::get_weight(std::uint16_t code, int color) {
+    return (WEIGHTS[code] >> (16 * color)) & 0xffff;
+}
+
+int Pattern::compute_weight(std::uint16_t code, int color) {
+    int states[NUM_NEIGHBORS];
+    int direction_cnt[4] = {0, 0, 0, 0};
+    int diagonal_cnt[4] = {0, 0, 0, 0};
+    for (int k = 0; k < NUM_NEIGHBORS; ++k) {
+        states[k] = get_state(code, k);
+        if (k < 4) {
+            direction_cnt[states[k]]++;
+        } else {
+            diagonal_cnt[states[k]]++;
+        }
+    }
+
+    const int own = color;
+    const int opp = !color;
+
+    // Our own eye, the same rule as Board::is_eyeshape().
+    if (direction_cnt[own] + direction_cnt[Board::INVLD] == 4) {
+        const int opp_diagonals = diagonal_cnt[opp];
+        if (diagonal_cnt[Board::INVLD] > 0 ? opp_diagonals == 0 : opp_diagonals <= 1) {
+            return 0;
+        }
+        // Filling the false eye is rarely urgent.
+        return FILL_WEIGHT;
+    }
+
+    const int direct_stones = direction_cnt[own] + direction_cnt[opp];
+    const int diagonal_stones = diagonal_cnt[own] + diagonal_cnt[opp];
+    if (direct_stones == 0 && diagonal_stones == 0) {
+        return direction_cnt[Board::INVLD] > 0 ? FIRST_LINE_WEIGHT : EMPTY_AREA_WEIGHT;
+    }
+    if (direct_stones == 0) {
+        return DIAGONAL_WEIGHT;
+    }
+
+    int weight = direction_cnt[opp] > 0 ? CONTACT_WEIGHT : 100;
+    for (const auto &corner : CORNERS) {
+        const int a = states[corner[0]];
+        const int b = states[corner[1]];
+        const int d = states[corner[2]];
+
+        if (a == opp && b == opp && d != opp) {
+            // Cut the two opponent stones.
+            weight = std::max(weight, CUT_WEIGHT);
+        } else if (a == own && b == own && d == opp) {
+            // Connect our two stones against the cut.
+            weight = std::max(weight, CONNECT_WEIGHT);
+        } else if ((a == opp && b != opp && d == own) ||
+                       (b == opp && a != opp && d == own)) {
+            // Hane, turn around the opponent stone.
+            weight = std::max(weight, HANE_WEIGHT);
+        }
+    }
+
+    if (direction_cnt[opp] == 0 && diagonal_cnt[opp] == 0) {
+        for (const auto &corner : CORNERS) {
+            if (states[corner[0]] == own && states[corner[1]] == own &&
+                    states[corner[2]] == Board::EMPTY) {
+                // The empty triangle, a bad shape.
+                weight = EMPTY_TRIANGLE_WEIGHT;
+            }
+        }
+    }
+    return weight;
+}
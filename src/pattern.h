@@ -0,0 +1,44 @@
+#ifndef PATTERN_H_INCLUDE
+#define PATTERN_H_INCLUDE
+
+#include <array>
+#include <cstdint>
+
+#include "board.h"
+
+// The 3x3 patterns for the playouts. The code of a point has 2 bits per
+// neighbor, the state (black, white, empty or invalid) of the neighbor k
+// in the bits 2k and 2k+1, so every 3x3 pattern is a 16-bit code. The
+// neighbors are the four directions of Board, then the four diagonals.
+// Board keeps the code of every point up to date.
+class Pattern {
+public:
+    static constexpr int NUM_PATTERNS = 1 << 16;
+
+    static constexpr int NUM_NEIGHBORS = 8;
+
+    // The weight of the hane, cut and connection. The playouts answer
+    // the last move with these shapes first.
+    static constexpr int SHAPE_WEIGHT = 200;
+
+    // The weights of the pattern for both colors, black in the low 16
+    // bits and white in the high 16 bits, so one lookup updates both.
+    // Our own eyes are zero. The playouts pick the points in proportion
+    // to the weights.
+    static std::array<std::uint32_t, NUM_PATTERNS> WEIGHTS;
+
+    // Fill the tables. It should be called once before any board is
+    // created.
+    static void initialize();
+
+    // Get the state of the neighbor k in the code.
+    static int get_state(std::uint16_t code, int k);
+
+    // Get the weight of the pattern for the color.
+    static int get_weight(std::uint16_t code, int color);
+
+    // Compute the weight of the pattern for the color from its shape.
+    static int compute_weight(std::uint16_t code, int color);
+};
+
+#endif
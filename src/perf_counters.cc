@@ -0,0 +1,143 @@
+#include "perf_counters.h"
+
+#ifdef ENABLE_PERF_COUNTERS
+
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+static const char *COUNTER_NAMES[PerfCounters::NUM_COUNTERS] = {
+    "moves_played",
+    "captures",
+    "merges",
+    "legal_checks",
+    "playouts",
+    "search_nodes",
+    "cache_probes",
+    "cache_hits",
+    "search_time_ms",
+    "eval_time_ms",
+    "playout_time_ms"
+};
+
+// The slots of the running threads. The lock is taken only when a thread
+// starts or ends, or the counters are read.
+struct PerfCounters::Registry {
+    std::mutex mutex;
+    Slot *live_slots = nullptr;
+    Values retired{};
+    Values base{};
+
+    // The counting of a thread after its slot is freed, in the
+    // destructors of other thread locals, goes here and is dropped.
+    Slot discarded{};
+
+    // Sum the retired totals and the live slots. The lock must be held.
+    Values sum() const {
+        auto values = retired;
+        for (auto slot = live_slots; slot; slot = slot->next) {
+            for (int i = 0; i < NUM_COUNTERS; ++i) {
+                values[i] += slot->counters[i].load(std::memory_order_relaxed);
+            }
+        }
+        return values;
+    }
+};
+
+// Fold the slot into the retired totals when its thread ends.
+struct PerfCounters::SlotOwner {
+    Slot *slot = nullptr;
+    Slot **cache = nullptr;
+
+    ~SlotOwner() {
+        if (!slot) {
+            return;
+        }
+        auto &registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            registry.retired[i] += slot->counters[i].load(std::memory_order_relaxed);
+        }
+        for (auto link = &registry.live_slots; *link; link = &(*link)->next) {
+            if (*link == slot) {
+                *link = slot->next;
+                break;
+            }
+        }
+        *cache = &registry.discarded;
+        delete slot;
+    }
+};
+
+PerfCounters::Registry &PerfCounters::get_registry() {
+    // Never destroyed, so the dump thread may still read it at exit.
+    static Registry *registry = new Registry;
+    return *registry;
+}
+
+PerfCounters::Slot *PerfCounters::register_slot(Slot **cache) {
+    auto &registry = get_registry();
+    auto slot = new Slot;
+    for (auto &c : slot->counters) {
+        c.store(0, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        slot->next = registry.live_slots;
+        registry.live_slots = slot;
+    }
+
+    static thread_local SlotOwner owner;
+    owner.slot = slot;
+    owner.cache = cache;
+    return slot;
+}
+
+PerfCounters::Values PerfCounters::get_values() {
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto values = registry.sum();
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        values[i] -= registry.base[i];
+    }
+    return values;
+}
+
+void PerfCounters::reset() {
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.base = registry.sum();
+}
+
+std::string PerfCounters::get_text() {
+    const auto values = get_values();
+
+    auto out = std::ostringstream{};
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        if (i > 0) {
+            out << '\n';
+        }
+        out << COUNTER_NAMES[i] << ' ';
+        if (i >= SEARCH_TIME) {
+            // The timers are in nanoseconds.
+            out << values[i] / 1000000;
+        } else {
+            out << values[i];
+        }
+    }
+    return out.str();
+}
+
+void PerfCounters::start_dump(double seconds) {
+    const auto period = std::chrono::duration<double>(seconds);
+    std::thread([period]() {
+        while (true) {
+            std::this_thread::sleep_for(period);
+            const auto text = get_text();
+            std::cerr << "perf counters:\n" << text << std::endl;
+        }
+    }).detach();
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef PERF_COUNTERS_H_INCLUDE
+#define PERF_COUNTERS_H_INCLUDE
+
+// The runtime counters and timers of the hot paths. They are compiled
+// only if ENABLE_PERF_COUNTERS is defined, for example
+//
+//     g++ src/*.cc -o bot -std=c++11 -O3 -pthread -DENABLE_PERF_COUNTERS
+//
+// Otherwise the PERF_* macros are empty and nothing is left in the code.
+
+#ifdef ENABLE_PERF_COUNTERS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Each thread counts into its own slot, so counting is a plain add
+// without any lock or atomic read-modify-write. The slots are summed
+// only when the counters are read. A slot of a finished thread is
+// folded into the retired totals.
+class PerfCounters {
+public:
+    enum counter_t {
+        MOVES_PLAYED = 0,
+        CAPTURES,
+        MERGES,
+        LEGAL_CHECKS,
+        PLAYOUTS,
+        SEARCH_NODES,
+        CACHE_PROBES,
+        CACHE_HITS,
+
+        // The timers in nanoseconds.
+        SEARCH_TIME,
+        EVAL_TIME,
+        PLAYOUT_TIME,
+
+        NUM_COUNTERS
+    };
+
+    using Clock = std::chrono::steady_clock;
+    using Values = std::array<std::uint64_t, NUM_COUNTERS>;
+
+    // Add to the counter of current thread.
+    static void add(counter_t counter, std::uint64_t value) {
+        auto &c = get_slot().counters[counter];
+        c.store(c.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    // Get the sums of all threads since the last reset.
+    static Values get_values();
+
+    // Make the current sums the new zero. The slots of the running
+    // threads are not written, so the reset never races with counting.
+    static void reset();
+
+    // Get the counters and timers as the text lines "name value".
+    static std::string get_text();
+
+    // Print the counters to stderr every given seconds in a background
+    // thread.
+    static void start_dump(double seconds);
+
+    // Add the elapsed time of its scope to the timer.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(counter_t timer)
+            : m_timer(timer), m_start(Clock::now()) {}
+
+        ~ScopedTimer() {
+            add(m_timer, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - m_start).count());
+        }
+
+    private:
+        counter_t m_timer;
+        Clock::time_point m_start;
+    };
+
+private:
+    // The padding keeps the counters of two threads off the same cache
+    // line.
+    struct Slot {
+        char front_padding[64];
+        std::array<std::atomic<std::uint64_t>, NUM_COUNTERS> counters;
+        Slot *next;
+        char back_padding[64];
+    };
+
+    static Slot &get_slot() {
+        // The trivial thread local pointer is cheaper than a thread local
+        // object, which checks its initialization on every access.
+        static thread_local Slot *slot = nullptr;
+        if (!slot) {
+            slot = register_slot(&slot);
+        }
+        return *slot;
+    }
+
+    // Defined in perf_counters.cc.
+    struct Registry;
+    struct SlotOwner;
+
+    static Registry &get_registry();
+    // Create the slot of current thread. The cached pointer is moved off
+    // the slot when the slot is freed at the thread exit.
+    static Slot *register_slot(Slot **cache);
+};
+
+#define PERF_ADD(counter, value) PerfCounters::add(PerfCounters::counter, (value))
+#define PERF_TIMER(timer) PerfCounters::ScopedTimer perf_timer_##timer(PerfCounters::timer)
+
+#else
+
+#define PERF_ADD(counter, value) ((void)0)
+#define PERF_TIMER(timer) ((void)0)
+
+#endif
+
+#define PERF_COUNT(counter) PERF_ADD(counter, 1)
+
+#endif
@@ -0,0 +1,55 @@
+#include <random>
+#include <thread>
+#include <functional>
+
+#include "random.h"
+
+static std::uint64_t splitmix64(std::uint64_t &seed) {
+    std::uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static std::uint64_t rotl(const std::uint64_t x, const int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+Random::Random(std::uint64_t seed) {
+    this->seed(seed);
+}
+
+Random &Random::get_rng() {
+    static thread_local Random rng(
+        std::random_device{}() ^
+        std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    return rng;
+}
+
+void Random::seed(std::uint64_t seed) {
+    m_s[0] = splitmix64(seed);
+    m_s[1] = splitmix64(seed);
+}
+
+std::uint64_t Random::randuint64() {
+    const std::uint64_t s0 = m_s[0];
+    std::uint64_t s1 = m_s[1];
+    const std::uint64_t result = s0 + s1;
+
+    s1 ^= s0;
+    m_s[0] = rotl(s0, 24) ^ s1 ^ (s1 << 16);
+    m_s[1] = rotl(s1, 37);
+
+    return result;
+}
+
+std::uint32_t Random::randfix(std::uint32_t max) {
+    // Lemire's multiply-shift range reduction.
+    const std::uint64_t r = randuint64() >> 32;
+    return static_cast<std::uint32_t>((r * max) >> 32);
+}
+
+float Random::randfloat() {
+    // Use the upper 24 bits for the float mantissa.
+    return (randuint64() >> 40) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,45 @@
+#ifndef RANDOM_H_INCLUDE
+#define RANDOM_H_INCLUDE
+
+#include <cstdint>
+#include <limits>
+
+// The xoroshiro128+ generator. It is much faster than std::mt19937 and
+// good enough for the playouts.
+class Random {
+public:
+    using result_type = std::uint64_t;
+
+    explicit Random(std::uint64_t seed);
+
+    // Get the generator of current thread. Each thread has its own
+    // generator with a different seed.
+    static Random &get_rng();
+
+    // Reset the state with the seed.
+    void seed(std::uint64_t seed);
+
+    std::uint64_t randuint64();
+
+    // Return a random number in [0, max).
+    std::uint32_t randfix(std::uint32_t max);
+
+    // Return a random number in [0, 1).
+    float randfloat();
+
+    // Make it work with the STL algorithms.
+    static constexpr result_type min() {
+        return std::numeric_limits<result_type>::min();
+    }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+    result_type operator()() {
+        return randuint64();
+    }
+
+private:
+    std::uint64_t m_s[2];
+};
+
+#endif
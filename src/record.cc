@@ -0,0 +1,457 @@
+#include "record.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+constexpr char GameRecord::MAGIC[8];
+constexpr int GameRecord::VERSION;
+constexpr int GameRecord::MIN_VERSION;
+constexpr int GameRecord::FILE_HEADER_SIZE;
+constexpr int GameRecord::GAME_HEADER_SIZE;
+constexpr int GameRecord::CHECKPOINT_INFO_SIZE;
+constexpr std::uint32_t GameRecord::SETUP_FLAG;
+constexpr int GameRecord::DEFAULT_CHECKPOINT_INTERVAL;
+
+// The ko move code if there is no ko.
+static constexpr std::uint16_t NO_KOMOVE = 0xffff;
+
+static void put_u8(std::vector<std::uint8_t> &buf, std::uint8_t v) {
+    buf.emplace_back(v);
+}
+
+static void put_u16(std::vector<std::uint8_t> &buf, std::uint16_t v) {
+    buf.emplace_back(v & 0xff);
+    buf.emplace_back(v >> 8);
+}
+
+static void put_u32(std::vector<std::uint8_t> &buf, std::uint32_t v) {
+    put_u16(buf, v & 0xffff);
+    put_u16(buf, v >> 16);
+}
+
+static void put_u64(std::vector<std::uint8_t> &buf, std::uint64_t v) {
+    put_u32(buf, v & 0xffffffff);
+    put_u32(buf, v >> 32);
+}
+
+static void put_float(std::vector<std::uint8_t> &buf, float v) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    put_u32(buf, bits);
+}
+
+static std::uint16_t get_u16(const std::uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static std::uint32_t get_u32(const std::uint8_t *p) {
+    return get_u16(p) | (static_cast<std::uint32_t>(get_u16(p+2)) << 16);
+}
+
+static std::uint64_t get_u64(const std::uint8_t *p) {
+    return get_u32(p) | (static_cast<std::uint64_t>(get_u32(p+4)) << 32);
+}
+
+static float get_float(const std::uint8_t *p) {
+    const std::uint32_t bits = get_u32(p);
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// The move codes need 9 bits up to 22x22 and pass.
+static int get_code_bits(int board_size) {
+    return board_size * board_size + 1 <= 512 ? 9 : 16;
+}
+
+static int get_checkpoint_size(int board_size) {
+    return GameRecord::CHECKPOINT_INFO_SIZE + (board_size * board_size + 3) / 4;
+}
+
+static int vertex_to_code(const Board &board, int vtx) {
+    const int board_size = board.get_board_size();
+    if (vtx == Board::PASS) {
+        return board_size * board_size;
+    }
+    return board.get_index(board.get_x(vtx), board.get_y(vtx));
+}
+
+static int code_to_vertex(const Board &board, int code) {
+    const int board_size = board.get_board_size();
+    if (code >= board_size * board_size) {
+        return Board::PASS;
+    }
+    return board.get_vertex(code % board_size, code / board_size);
+}
+
+// Read the code at the index. Every code spans exactly two bytes, since
+// a 9-bit code starts in the first eight bits and the 16-bit codes are
+// byte aligned.
+static int read_code(const std::uint8_t *codes, int idx, int bits) {
+    const std::size_t bit = static_cast<std::size_t>(idx) * bits;
+    const std::uint8_t *p = codes + bit / 8;
+    const std::uint32_t v = p[0] | (p[1] << 8);
+    return (v >> (bit % 8)) & ((1u << bits) - 1);
+}
+
+// Write the board in the checkpoint layout, the move state and two bits
+// per point.
+static void put_checkpoint(std::vector<std::uint8_t> &buf, const Board &board) {
+    const int board_size = board.get_board_size();
+    const int komove = board.get_komove();
+    put_u16(buf, komove == Board::NULL_VERTEX ?
+                     NO_KOMOVE : vertex_to_code(board, komove));
+    put_u8(buf, board.get_tomove());
+    put_u8(buf, std::min(board.get_passes(), 255));
+
+    std::uint8_t bits = 0;
+    int num_bits = 0;
+    for (int idx = 0; idx < board_size * board_size; ++idx) {
+        const int vtx = board.get_vertex(idx % board_size, idx / board_size);
+        bits |= board.get_state(vtx) << num_bits;
+        num_bits += 2;
+        if (num_bits == 8) {
+            put_u8(buf, bits);
+            bits = 0;
+            num_bits = 0;
+        }
+    }
+    if (num_bits > 0) {
+        put_u8(buf, bits);
+    }
+}
+
+// Place the stones of the checkpoint on the empty board.
+static void load_checkpoint_stones(const std::uint8_t *p, Board &board) {
+    const int board_size = board.get_board_size();
+    const auto stones = p + GameRecord::CHECKPOINT_INFO_SIZE;
+
+    for (int idx = 0; idx < board_size * board_size; ++idx) {
+        const int state = (stones[idx / 4] >> (2 * (idx % 4))) & 3;
+        if (state == Board::BLACK || state == Board::WHITE) {
+            board.set_stone(board.get_vertex(idx % board_size, idx / board_size), state);
+        }
+    }
+}
+
+GameRecordWriter::~GameRecordWriter() {
+    close();
+}
+
+bool GameRecordWriter::open(const std::string &filename, int checkpoint_interval) {
+    close();
+
+    m_file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        return false;
+    }
+    m_offsets.clear();
+    m_interval = std::max(checkpoint_interval, 0);
+
+    // The header is written again in close().
+    m_block.assign(GameRecord::FILE_HEADER_SIZE, 0);
+    m_file.write(reinterpret_cast<const char *>(m_block.data()), m_block.size());
+    m_offset = m_block.size();
+
+    return static_cast<bool>(m_file);
+}
+
+bool GameRecordWriter::write_game(const GameState &state, float result) {
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    const int board_size = state.get_board_size();
+    const int num_moves = state.get_movenum();
+    const int code_bits = get_code_bits(board_size);
+    const int num_checkpoints = m_interval > 0 ? num_moves / m_interval : 0;
+    const auto &setup_stones = state.get_setup_stones();
+
+    auto &block = m_block;
+    block.clear();
+
+    put_u8(block, board_size);
+    put_u8(block, code_bits);
+    put_u16(block, m_interval);
+    put_float(block, state.get_komi());
+    put_float(block, result);
+    put_u32(block, num_moves);
+    put_u32(block, num_checkpoints);
+    put_u32(block, setup_stones.empty() ? 0 : GameRecord::SETUP_FLAG);
+
+    Board board;
+    board.reset_board(board_size);
+
+    if (!setup_stones.empty()) {
+        for (const auto &stone : setup_stones) {
+            board.set_stone(stone.first, stone.second);
+        }
+        // The side to move after the setup.
+        board.set_to_move(num_moves > 0 ? state.get_move_color(1) : state.get_tomove());
+        put_checkpoint(block, board);
+    }
+
+    // The move codes, least significant bit first.
+    std::uint32_t acc = 0;
+    int acc_bits = 0;
+    for (int i = 1; i <= num_moves; ++i) {
+        acc |= static_cast<std::uint32_t>(vertex_to_code(board, state.get_move(i))) << acc_bits;
+        acc_bits += code_bits;
+        while (acc_bits >= 8) {
+            put_u8(block, acc & 0xff);
+            acc >>= 8;
+            acc_bits -= 8;
+        }
+    }
+    if (acc_bits > 0) {
+        put_u8(block, acc);
+    }
+
+    // The colors, one bit per move.
+    for (int i = 0; i < num_moves; i += 8) {
+        std::uint8_t bits = 0;
+        for (int k = 0; k < 8 && i+k < num_moves; ++k) {
+            if (state.get_move_color(i+k+1) == Board::WHITE) {
+                bits |= 1 << k;
+            }
+        }
+        put_u8(block, bits);
+    }
+
+    // The checkpoints.
+    for (int i = 1; i <= num_moves; ++i) {
+        board.play_move_assume_legal(state.get_move(i), state.get_move_color(i));
+        board.clear_undo();
+
+        if (m_interval != 0 && i % m_interval == 0) {
+            put_checkpoint(block, board);
+        }
+    }
+
+    m_file.write(reinterpret_cast<const char *>(block.data()), block.size());
+    m_offsets.emplace_back(m_offset);
+    m_offset += block.size();
+
+    return static_cast<bool>(m_file);
+}
+
+bool GameRecordWriter::close() {
+    if (!m_file.is_open()) {
+        return true;
+    }
+
+    auto &buf = m_block;
+    buf.clear();
+    for (const auto offset : m_offsets) {
+        put_u64(buf, offset);
+    }
+    m_file.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+
+    buf.clear();
+    for (const char c : GameRecord::MAGIC) {
+        put_u8(buf, c);
+    }
+    put_u32(buf, GameRecord::VERSION);
+    put_u32(buf, m_offsets.size());
+    put_u64(buf, m_offset);
+    put_u64(buf, 0);
+
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+
+    const bool success = static_cast<bool>(m_file);
+    m_file.close();
+    return success;
+}
+
+int GameRecordWriter::get_num_games() const {
+    return m_offsets.size();
+}
+
+bool GameRecordReader::open(const std::string &filename) {
+    close();
+
+    if (!m_file.open(filename)) {
+        return false;
+    }
+
+    const auto data = reinterpret_cast<const std::uint8_t *>(m_file.data());
+    const auto size = m_file.size();
+
+    if (size < static_cast<std::size_t>(GameRecord::FILE_HEADER_SIZE) ||
+            std::memcmp(data, GameRecord::MAGIC, sizeof(GameRecord::MAGIC)) != 0) {
+        close();
+        return false;
+    }
+    const std::uint32_t version = get_u32(data + 8);
+    if (version < static_cast<std::uint32_t>(GameRecord::MIN_VERSION) ||
+            version > static_cast<std::uint32_t>(GameRecord::VERSION)) {
+        close();
+        return false;
+    }
+
+    const std::uint64_t num_games = get_u32(data + 12);
+    const std::uint64_t index_offset = get_u64(data + 16);
+    if (index_offset > size || (size - index_offset) / 8 < num_games) {
+        close();
+        return false;
+    }
+
+    m_num_games = num_games;
+    m_index = data + index_offset;
+    return true;
+}
+
+void GameRecordReader::close() {
+    m_file.close();
+    m_num_games = 0;
+    m_index = nullptr;
+}
+
+int GameRecordReader::get_num_games() const {
+    return m_num_games;
+}
+
+bool GameRecordReader::get_view(int game, GameView &view) const {
+    if (game < 0 || game >= m_num_games) {
+        return false;
+    }
+
+    const auto data = reinterpret_cast<const std::uint8_t *>(m_file.data());
+    const auto index_offset = static_cast<std::uint64_t>(m_index - data);
+    const std::uint64_t offset = get_u64(m_index + 8 * game);
+
+    if (offset > index_offset ||
+            index_offset - offset < static_cast<std::uint64_t>(GameRecord::GAME_HEADER_SIZE)) {
+        return false;
+    }
+
+    const auto p = data + offset;
+    view.board_size = p[0];
+    view.code_bits = p[1];
+    view.interval = get_u16(p + 2);
+    view.komi = get_float(p + 4);
+    view.result = get_float(p + 8);
+    view.num_moves = get_u32(p + 12);
+    view.num_checkpoints = get_u32(p + 16);
+    const std::uint32_t flags = get_u32(p + 20);
+
+    if (view.board_size < 2 || view.board_size > Board::BOARD_SIZE ||
+            view.code_bits != get_code_bits(view.board_size) ||
+            view.num_moves < 0 || view.num_checkpoints < 0 ||
+            (view.interval == 0 && view.num_checkpoints != 0) ||
+            (flags & ~GameRecord::SETUP_FLAG) != 0) {
+        return false;
+    }
+
+    view.checkpoint_size = get_checkpoint_size(view.board_size);
+    const int setup_size = flags & GameRecord::SETUP_FLAG ? view.checkpoint_size : 0;
+
+    const std::uint64_t codes_size =
+        (static_cast<std::uint64_t>(view.num_moves) * view.code_bits + 7) / 8;
+    const std::uint64_t colors_size = (static_cast<std::uint64_t>(view.num_moves) + 7) / 8;
+    const std::uint64_t block_size = GameRecord::GAME_HEADER_SIZE + setup_size +
+                                         codes_size + colors_size +
+                                         static_cast<std::uint64_t>(view.num_checkpoints) *
+                                             view.checkpoint_size;
+    if (index_offset - offset < block_size) {
+        return false;
+    }
+
+    view.setup = setup_size > 0 ? p + GameRecord::GAME_HEADER_SIZE : nullptr;
+    view.codes = p + GameRecord::GAME_HEADER_SIZE + setup_size;
+    view.colors = view.codes + codes_size;
+    view.checkpoints = view.colors + colors_size;
+    return true;
+}
+
+bool GameRecordReader::get_info(int game, GameRecordInfo &info) const {
+    GameView view;
+    if (!get_view(game, view)) {
+        return false;
+    }
+    info.board_size = view.board_size;
+    info.komi = view.komi;
+    info.result = view.result;
+    info.num_moves = view.num_moves;
+    return true;
+}
+
+int GameRecordReader::get_move(int game, int movenum, int &color) const {
+    GameView view;
+    if (!get_view(game, view) || movenum < 1 || movenum > view.num_moves) {
+        return Board::NULL_VERTEX;
+    }
+
+    const int idx = movenum - 1;
+    color = (view.colors[idx / 8] >> (idx % 8)) & 1 ? Board::WHITE : Board::BLACK;
+
+    const int code = read_code(view.codes, idx, view.code_bits);
+    const int board_size = view.board_size;
+    if (code >= board_size * board_size) {
+        return Board::PASS;
+    }
+    // Same as Board::get_vertex().
+    return (code / board_size + 1) * (board_size+2) + (code % board_size + 1);
+}
+
+bool GameRecordReader::get_position(int game, int num_moves, Board &board) const {
+    GameView view;
+    if (!get_view(game, view) || num_moves < 0 || num_moves > view.num_moves) {
+        return false;
+    }
+
+    const int board_size = view.board_size;
+    board.reset_board(board_size);
+
+    int start = 0;
+    const int checkpoint = view.interval > 0 ?
+                               std::min(num_moves / view.interval, view.num_checkpoints) : 0;
+    if (checkpoint > 0) {
+        const auto p = view.checkpoints +
+                           static_cast<std::size_t>(checkpoint - 1) * view.checkpoint_size;
+        load_checkpoint_stones(p, board);
+
+        start = checkpoint * view.interval;
+
+        const int komove_code = get_u16(p);
+        const int komove = komove_code == NO_KOMOVE ?
+                               Board::NULL_VERTEX : code_to_vertex(board, komove_code);
+        const int last_move = code_to_vertex(board, read_code(view.codes, start-1, view.code_bits));
+        board.set_move_state(p[2], komove, last_move, p[3]);
+    } else if (view.setup) {
+        // The checkpoints already have the setup stones.
+        load_checkpoint_stones(view.setup, board);
+        board.set_move_state(view.setup[2], Board::NULL_VERTEX, Board::NULL_VERTEX, 0);
+    }
+
+    for (int i = start; i < num_moves; ++i) {
+        const int code = read_code(view.codes, i, view.code_bits);
+        const int color = (view.colors[i / 8] >> (i % 8)) & 1 ? Board::WHITE : Board::BLACK;
+        board.play_move_assume_legal(code_to_vertex(board, code), color);
+    }
+    return true;
+}
+
+bool convert_sgf_to_record(const std::string &sgf_filename,
+                               const std::string &record_filename,
+                               int threads, SgfReplayStats &stats) {
+    GameRecordWriter writer;
+    if (!writer.open(record_filename)) {
+        return false;
+    }
+
+    std::mutex writer_mutex;
+    bool success = true;
+    const auto write_game = [&](int, const GameState &state, float result) {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        success &= writer.write_game(state, result);
+    };
+
+    if (!sgf_replay_file(sgf_filename, threads, stats, write_game)) {
+        return false;
+    }
+    return writer.close() && success;
+}
@@ -0,0 +1,151 @@
+#ifndef RECORD_H_INCLUDE
+#define RECORD_H_INCLUDE
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "game_state.h"
+#include "mapped_file.h"
+#include "sgf.h"
+
+// The binary game record file. All numbers are little-endian.
+//
+//   file header   magic "GORECORD", version, number of games and the
+//                 offset of index
+//   game blocks   one block per game
+//   index         the offset of every game block, uint64 per game
+//
+// A game block starts with a fixed header (board size, move code bits,
+// checkpoint interval, komi, result, number of moves and checkpoints,
+// flags). If the game has setup stones, the setup board follows in the
+// checkpoint layout. The moves follow as 9-bit codes, or 16-bit codes
+// on the boards larger than 22x22, then one color bit per move and the
+// checkpoints. The checkpoint k is the board after (k+1) * interval
+// moves, two bits per point, so any position is less than interval
+// moves away from a stored board.
+class GameRecord {
+public:
+    static constexpr char MAGIC[8] = {'G', 'O', 'R', 'E', 'C', 'O', 'R', 'D'};
+    static constexpr int VERSION = 2;
+
+    // The files of version 1 have no setup board.
+    static constexpr int MIN_VERSION = 1;
+
+    static constexpr int FILE_HEADER_SIZE = 32;
+    static constexpr int GAME_HEADER_SIZE = 24;
+
+    // The ko move, side to move and passes before the stones.
+    static constexpr int CHECKPOINT_INFO_SIZE = 4;
+
+    // The game flag of the setup board.
+    static constexpr std::uint32_t SETUP_FLAG = 1;
+
+    static constexpr int DEFAULT_CHECKPOINT_INTERVAL = 32;
+};
+
+struct GameRecordInfo {
+    int board_size;
+    float komi;
+
+    // The black score, +/-infinity if only the winner is known and NaN if
+    // it is unknown.
+    float result;
+
+    int num_moves;
+};
+
+class GameRecordWriter {
+public:
+    ~GameRecordWriter();
+
+    // Create the file. The checkpoint is stored every interval moves,
+    // zero means no checkpoint.
+    bool open(const std::string &filename,
+                  int checkpoint_interval = GameRecord::DEFAULT_CHECKPOINT_INTERVAL);
+
+    // Append the setup stones and the moves of the game. The result is
+    // the black score.
+    bool write_game(const GameState &state, float result);
+
+    // Write the index and the file header, and close the file. Return
+    // false if any write failed.
+    bool close();
+
+    int get_num_games() const;
+
+private:
+    std::ofstream m_file;
+
+    // The offsets of written game blocks.
+    std::vector<std::uint64_t> m_offsets;
+
+    std::uint64_t m_offset{0};
+
+    int m_interval{0};
+
+    // The reused buffer of one game block.
+    std::vector<std::uint8_t> m_block;
+};
+
+// Read the records from the memory-mapped file. Every query reads the
+// mapped bytes directly, so the threads could share one reader.
+class GameRecordReader {
+public:
+    // Return false if the file could not be opened or is not a record
+    // file.
+    bool open(const std::string &filename);
+
+    void close();
+
+    int get_num_games() const;
+
+    // Return false if the game block is broken.
+    bool get_info(int game, GameRecordInfo &info) const;
+
+    // Get the move played at the move number, starting from 1, and its
+    // color. Return NULL_VERTEX if there is no such move.
+    int get_move(int game, int movenum, int &color) const;
+
+    // Set the board to the position after num_moves moves. It starts
+    // from the nearest checkpoint, so the moves before it can not be
+    // undone. Return false if there is no such position.
+    bool get_position(int game, int num_moves, Board &board) const;
+
+private:
+    // The decoded game header and the parts of the block. The setup board
+    // is null if there are no setup stones.
+    struct GameView {
+        int board_size;
+        int code_bits;
+        int interval;
+        float komi;
+        float result;
+        int num_moves;
+        int num_checkpoints;
+        const std::uint8_t *setup;
+        const std::uint8_t *codes;
+        const std::uint8_t *colors;
+        const std::uint8_t *checkpoints;
+        int checkpoint_size;
+    };
+
+    // Decode the game block. Return false if it is out of the file.
+    bool get_view(int game, GameView &view) const;
+
+    MappedFile m_file;
+
+    int m_num_games{0};
+
+    const std::uint8_t *m_index{nullptr};
+};
+
+// Replay all games of the SGF file on the given threads and write them
+// to the record file. The games are written in the finished order.
+bool convert_sgf_to_record(const std::string &sgf_filename,
+                               const std::string &record_filename,
+                               int threads, SgfReplayStats &stats);
+
+#endif
@@ -0,0 +1,586 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "search.h"
+#include "random.h"
+#include "evaluator.h"
+#include "symmetry.h"
+#include "perf_counters.h"
+#include "ladder.h"
+
+constexpr int Search::DEFAULT_PLAYOUTS;
+constexpr std::uint32_t Search::NULL_NODE;
+constexpr int Search::VIRTUAL_LOSS;
+constexpr int Search::WIN_VALUE;
+constexpr int Search::TT_MIN_VISITS;
+
+using Clock = std::chrono::steady_clock;
+
+// Mix the komi into the position hash, so the results of different
+// komi do not share the transposition table entries.
+static std::uint64_t get_komi_key(float komi) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &komi, sizeof(bits));
+
+    // The finalizer of splitmix64.
+    std::uint64_t key = bits;
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+Search::Search() {
+    m_playouts = 0;
+    m_visits = 0;
+    m_time = 0.0;
+    m_uct_c = 0.7f;
+    m_threads = 1;
+    m_verbose = true;
+    m_last_playouts = 0;
+    m_last_elapsed = 0.0;
+    m_pondering = false;
+    m_time_limit = 0.0;
+    m_running.store(false);
+    m_tt = std::make_shared<TranspositionTable>();
+    m_shared_tt = false;
+    m_evaluator = nullptr;
+    set_max_nodes(1 << 20);
+}
+
+Search::~Search() {
+    stop_ponder();
+}
+
+void Search::set_playouts(int playouts) {
+    m_playouts = std::max(playouts, 0);
+}
+
+void Search::set_visits(int visits) {
+    m_visits = std::max(visits, 0);
+}
+
+void Search::set_time(double seconds) {
+    m_time = std::max(seconds, 0.0);
+}
+
+void Search::set_max_nodes(int max_nodes) {
+    m_arena_size = std::max(max_nodes, 1);
+    m_arena.reset(new Node[m_arena_size]);
+    reset_tree();
+}
+
+void Search::set_threads(int threads) {
+    m_threads = std::max(threads, 1);
+}
+
+void Search::set_verbose(bool verbose) {
+    m_verbose = verbose;
+}
+
+void Search::set_tt_size(int megabytes) {
+    m_tt->resize(std::max(megabytes, 1));
+}
+
+void Search::clear_tt() {
+    m_tt->clear();
+}
+
+void Search::clear_tree() {
+    stop_ponder();
+    reset_tree();
+}
+
+void Search::set_evaluator(BatchEvaluator *evaluator) {
+    m_evaluator = evaluator;
+}
+
+void Search::set_tt(std::shared_ptr<TranspositionTable> tt) {
+    m_tt = tt;
+    m_shared_tt = true;
+}
+
+int Search::get_playouts() const {
+    return m_playouts;
+}
+
+int Search::get_visits() const {
+    return m_visits;
+}
+
+double Search::get_time() const {
+    return m_time;
+}
+
+int Search::get_max_nodes() const {
+    return m_arena_size;
+}
+
+int Search::get_threads() const {
+    return m_threads;
+}
+
+int Search::get_last_playouts() const {
+    return m_last_playouts;
+}
+
+double Search::get_last_elapsed() const {
+    return m_last_elapsed;
+}
+
+void Search::init_node(std::uint32_t node, int vtx) {
+    auto &n = m_arena[node];
+    n.vtx = vtx;
+    n.num_children = 0;
+    n.first_child = NULL_NODE;
+    n.expand_state.store(UNEXPANDED, std::memory_order_relaxed);
+    n.visits.store(0, std::memory_order_relaxed);
+    n.virtual_loss.store(0, std::memory_order_relaxed);
+    n.wins.store(0, std::memory_order_relaxed);
+}
+
+std::uint32_t Search::allocate_nodes(int size) {
+    // Check the bound before taking the nodes, so the counter never
+    // passes the arena size and could not wrap.
+    auto idx = m_arena_used.load();
+    do {
+        if (static_cast<std::uint32_t>(size) > m_arena_size - idx) {
+            // Count the arena as full, so the search stops.
+            m_arena_used.store(m_arena_size);
+            return NULL_NODE;
+        }
+    } while (!m_arena_used.compare_exchange_weak(idx, idx + size));
+    return idx;
+}
+
+void Search::reset_tree() {
+    m_arena_used.store(0);
+    m_root = allocate_nodes(1);
+    init_node(m_root, Board::NULL_VERTEX);
+    m_root_hash = 0;
+    m_root_movenum = -1;
+}
+
+void Search::prepare_root(GameState &state) {
+    // The tree of another komi has different values.
+    const auto komi_key = get_komi_key(state.get_komi());
+    const int moves = state.get_movenum() - m_root_movenum;
+    auto node = m_root;
+    bool reuse = m_root_movenum >= 0 && moves >= 0 && moves <= 2 &&
+                     m_arena_used.load() < m_arena_size / 4 * 3;
+
+    if (reuse) {
+        // Be sure the old root is the position before these moves.
+        auto prev_state = state;
+        for (int i = 0; i < moves; ++i) {
+            prev_state.undo_move();
+        }
+        reuse = (prev_state.board.get_hash() ^ komi_key) == m_root_hash;
+    }
+
+    for (int i = 1; reuse && i <= moves; ++i) {
+        const int vtx = state.get_move(m_root_movenum + i);
+        const auto &n = m_arena[node];
+
+        reuse = false;
+        if (n.expand_state.load() != EXPANDED) {
+            break;
+        }
+        for (int c = 0; c < n.num_children; ++c) {
+            if (m_arena[n.first_child + c].vtx == vtx) {
+                node = n.first_child + c;
+                reuse = true;
+                break;
+            }
+        }
+    }
+
+    if (reuse) {
+        m_root = node;
+    } else {
+        reset_tree();
+    }
+
+    m_reused_visits = m_arena[m_root].visits.load();
+    m_root_hash = state.board.get_hash() ^ komi_key;
+    m_root_movenum = state.get_movenum();
+
+    if (m_arena[m_root].expand_state.load() == UNEXPANDED) {
+        expand(m_root, state);
+    }
+}
+
+void Search::expand(std::uint32_t node, GameState &state) {
+    auto &n = m_arena[node];
+
+    auto expected = static_cast<std::uint8_t>(UNEXPANDED);
+    if (!n.expand_state.compare_exchange_strong(expected, EXPANDING)) {
+        // The other thread is expanding it.
+        return;
+    }
+
+    const int color = state.get_tomove();
+    auto moves = state.board.legal_moves(color);
+
+    // Never fill our own eyes, like the playouts.
+    moves.erase(
+        std::remove_if(std::begin(moves), std::end(moves),
+                       [&state, color](int vtx) {
+                           return state.board.is_eyeshape(vtx, color) ||
+                                      !state.legal_move(vtx, color);
+                       }),
+        std::end(moves));
+
+    // Running from a ladder which fails only loses more stones.
+    Ladder::remove_failed_escapes(state.board, color, moves);
+    moves.emplace_back(Board::PASS);
+
+    if (node == m_root) {
+        // The symmetric root moves lead to the same results, like the
+        // 8-fold points of the empty board, so search only one of them.
+        Symmetry::remove_symmetric_moves(state.board, moves);
+    }
+
+    // The unvisited children are selected in order, so shuffle them.
+    std::shuffle(std::begin(moves), std::end(moves), Random::get_rng());
+
+    const auto first_child = allocate_nodes(moves.size());
+    if (first_child == NULL_NODE) {
+        // The arena is full. The node stays EXPANDING and works as a
+        // leaf from now on.
+        return;
+    }
+
+    for (int i = 0; i < (int)moves.size(); ++i) {
+        init_node(first_child + i, moves[i]);
+    }
+    PERF_ADD(SEARCH_NODES, moves.size());
+    n.first_child = first_child;
+    n.num_children = moves.size();
+    n.expand_state.store(EXPANDED, std::memory_order_release);
+}
+
+std::uint32_t Search::select_child(std::uint32_t node) const {
+    const auto &parent = m_arena[node];
+    const int parent_visits = parent.visits.load(std::memory_order_relaxed) +
+                                  parent.virtual_loss.load(std::memory_order_relaxed);
+    const float log_visits = std::log(static_cast<float>(parent_visits + 1));
+
+    auto best = NULL_NODE;
+    float best_value = -1.f;
+
+    for (int i = 0; i < parent.num_children; ++i) {
+        const auto idx = parent.first_child + i;
+        const auto &child = m_arena[idx];
+
+        // The virtual losses count as lost games.
+        const int visits = child.visits.load(std::memory_order_relaxed) +
+                               child.virtual_loss.load(std::memory_order_relaxed);
+        if (visits == 0) {
+            // Visit each child at least once.
+            return idx;
+        }
+
+        const float q = static_cast<float>(child.wins.load(std::memory_order_relaxed)) /
+                            (static_cast<float>(WIN_VALUE) * visits);
+        const float u = m_uct_c * std::sqrt(log_visits / visits);
+        if (q + u > best_value) {
+            best_value = q + u;
+            best = idx;
+        }
+    }
+    return best;
+}
+
+void Search::play_simulation(GameState &state) {
+    const int root_color = state.get_tomove();
+
+    std::uint32_t path[Board::NUM_INTESECTIONS * 3 + 1];
+    std::uint64_t hashes[Board::NUM_INTESECTIONS * 3 + 1];
+    int depth = 0;
+
+    const auto komi_key = get_komi_key(state.get_komi());
+
+    auto node = m_root;
+    path[depth] = node;
+    hashes[depth] = state.board.get_hash() ^ komi_key;
+
+    while (m_arena[node].expand_state.load(std::memory_order_acquire) == EXPANDED &&
+               state.get_passes() < 2 &&
+               depth < Board::NUM_INTESECTIONS * 3) {
+        const auto child = select_child(node);
+        auto &c = m_arena[child];
+        c.virtual_loss.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+        if (!state.play_move(c.vtx, state.get_tomove())) {
+            // The reused tree was searched with another history, and the
+            // move repeats a position of this one. Count it as a loss of
+            // the mover, so the selection avoids it, and evaluate the
+            // parent instead.
+            c.visits.fetch_add(1, std::memory_order_relaxed);
+            c.virtual_loss.fetch_sub(VIRTUAL_LOSS, std::memory_order_relaxed);
+            break;
+        }
+        node = child;
+        path[++depth] = node;
+        hashes[depth] = state.board.get_hash() ^ komi_key;
+    }
+
+    // The result in half points, 0 (loss), 1 (draw) or 2 (win).
+    int black_result = -1;
+    int black_value = 0;
+
+    if (state.get_passes() >= 2) {
+        const float black_score = state.final_score();
+        black_result = (black_score > 0.f) ? 2 : ((black_score < 0.f) ? 0 : 1);
+    } else {
+        if (m_arena[node].visits.load(std::memory_order_relaxed) > 0) {
+            expand(node, state);
+        }
+
+        int tt_visits, tt_black_wins;
+        bool tt_hit = false;
+        if (!m_evaluator) {
+            m_tt_probes.fetch_add(1, std::memory_order_relaxed);
+            tt_hit = m_tt->probe(hashes[depth], tt_visits, tt_black_wins);
+            if (tt_hit) {
+                m_tt_hits.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (m_evaluator) {
+            NetResult result;
+            {
+                PERF_TIMER(EVAL_TIME);
+                m_evaluator->evaluate(state.board, result);
+            }
+
+            // The value is from the view of the side to move.
+            const float winrate = (result.value + 1.f) / 2.f;
+            const float black_winrate = state.get_tomove() == Board::BLACK ?
+                                            winrate : 1.f - winrate;
+            black_value = static_cast<int>(black_winrate * WIN_VALUE);
+        } else if (tt_hit && tt_visits >= TT_MIN_VISITS &&
+                Random::get_rng().randfix(tt_visits) >= TT_MIN_VISITS) {
+            // Use the mean result of previous playouts.
+            black_value = static_cast<std::int64_t>(tt_black_wins) * WIN_VALUE /
+                              (2 * tt_visits);
+            m_tt_evals.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            const float black_score = state.random_playout();
+            black_result = (black_score > 0.f) ? 2 : ((black_score < 0.f) ? 0 : 1);
+        }
+    }
+
+    if (black_result >= 0) {
+        black_value = black_result * WIN_VALUE / 2;
+
+        // Only the real results go into the table.
+        for (int i = 0; i <= depth; ++i) {
+            m_tt->update(hashes[i], black_result);
+        }
+    }
+
+    for (int i = 0; i <= depth; ++i) {
+        // The root move is played by the opponent.
+        const int color = (i % 2 == 1) ? root_color : !root_color;
+        auto &n = m_arena[path[i]];
+
+        n.wins.fetch_add(color == Board::BLACK ? black_value : WIN_VALUE - black_value,
+                             std::memory_order_relaxed);
+        n.visits.fetch_add(1, std::memory_order_relaxed);
+        if (i > 0) {
+            n.virtual_loss.fetch_sub(VIRTUAL_LOSS, std::memory_order_relaxed);
+        }
+    }
+
+    for (int i = 0; i < depth; ++i) {
+        state.undo_move();
+    }
+}
+
+void Search::worker(GameState state) {
+    while (m_running.load(std::memory_order_relaxed)) {
+        play_simulation(state);
+
+        const int playouts = m_running_playouts.fetch_add(1) + 1;
+        const double elapsed =
+            std::chrono::duration<double>(Clock::now() - m_start_time).count();
+        if (stop_thinking(playouts, elapsed)) {
+            m_running.store(false);
+        }
+    }
+}
+
+bool Search::stop_thinking(int playouts, double elapsed) const {
+    if (m_pondering) {
+        // Stop if the tree could not grow anymore.
+        return m_arena_used.load() >= m_arena_size;
+    }
+
+    if (m_time_limit > 0.0 && elapsed >= m_time_limit) {
+        return true;
+    }
+
+    const bool no_limit = m_playouts == 0 && m_visits == 0 &&
+                              m_time <= 0.0 && m_time_limit <= 0.0;
+    const int playouts_limit = no_limit ? DEFAULT_PLAYOUTS : m_playouts;
+
+    if (playouts_limit > 0 && playouts >= playouts_limit) {
+        return true;
+    }
+    if (m_visits > 0 && m_arena[m_root].visits.load() >= m_visits) {
+        return true;
+    }
+    if (m_time > 0.0 && elapsed >= m_time) {
+        return true;
+    }
+    return false;
+}
+
+void Search::run_search(GameState state) {
+    PERF_TIMER(SEARCH_TIME);
+    m_start_time = Clock::now();
+    m_running_playouts.store(0);
+    m_tt_evals.store(0);
+    m_tt_probes.store(0);
+    m_tt_hits.store(0);
+    if (!m_shared_tt) {
+        m_tt->new_search();
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < m_threads; ++i) {
+        threads.emplace_back(&Search::worker, this, state);
+    }
+    worker(state);
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    m_last_playouts = m_running_playouts.load();
+    m_last_elapsed = std::chrono::duration<double>(Clock::now() - m_start_time).count();
+}
+
+int Search::think(GameState &state, int color, double time_limit) {
+    auto work_state = state;
+    if (work_state.get_tomove() != color) {
+        work_state.set_to_move(color);
+    }
+
+    prepare_root(work_state);
+
+    m_pondering = false;
+    m_time_limit = time_limit;
+    m_running.store(true);
+    run_search(work_state);
+
+    if (m_verbose) {
+        dump_stats(work_state, m_last_playouts, m_last_elapsed);
+    }
+    return get_best_move();
+}
+
+void Search::start_ponder(GameState &state) {
+    stop_ponder();
+
+    auto work_state = state;
+    prepare_root(work_state);
+
+    m_pondering = true;
+    m_running.store(true);
+    m_ponder_thread = std::thread(&Search::run_search, this, work_state);
+}
+
+void Search::stop_ponder() {
+    if (!m_ponder_thread.joinable()) {
+        return;
+    }
+    m_running.store(false);
+    m_ponder_thread.join();
+    m_pondering = false;
+
+    if (m_verbose) {
+        std::cerr << "pondered " << m_last_playouts << " playouts, "
+                      << m_arena[m_root].visits.load() << " root visits"
+                      << std::endl;
+    }
+}
+
+int Search::get_best_move() const {
+    const auto &root = m_arena[m_root];
+    int best_move = Board::PASS;
+    int best_visits = -1;
+
+    for (int i = 0; i < root.num_children; ++i) {
+        const auto &child = m_arena[root.first_child + i];
+        if (child.visits.load() > best_visits) {
+            best_visits = child.visits.load();
+            best_move = child.vtx;
+        }
+    }
+    return best_move;
+}
+
+void Search::dump_stats(GameState &state, int playouts, double elapsed) const {
+    const auto &root = m_arena[m_root];
+
+    std::vector<std::uint32_t> children;
+    for (int i = 0; i < root.num_children; ++i) {
+        if (m_arena[root.first_child + i].visits.load() > 0) {
+            children.emplace_back(root.first_child + i);
+        }
+    }
+    std::sort(std::begin(children), std::end(children),
+                  [this](std::uint32_t a, std::uint32_t b) {
+                      return m_arena[a].visits.load() > m_arena[b].visits.load();
+                  });
+
+    std::ostringstream out;
+    const int show_size = std::min((int)children.size(), 10);
+    for (int i = 0; i < show_size; ++i) {
+        const auto &child = m_arena[children[i]];
+        const int visits = child.visits.load();
+        out << std::setw(6) << state.vertex_to_text(child.vtx)
+                << " -> visits: " << std::setw(7) << visits
+                << ", winrate: " << std::fixed << std::setprecision(2)
+                << std::setw(6) << 100.f * child.wins.load() / (WIN_VALUE * visits) << "%"
+                << std::endl;
+    }
+
+    out << playouts << " playouts, "
+            << std::fixed << std::setprecision(2) << elapsed << " sec, "
+            << static_cast<int>(playouts / std::max(elapsed, 1e-6)) << " playouts/sec, "
+            << std::min(m_arena_used.load(), m_arena_size) << " nodes, "
+            << m_threads << " threads, "
+            << m_reused_visits << " visits reused"
+            << std::endl;
+
+    const int probes = m_tt_probes.load();
+    const int hits = m_tt_hits.load();
+    out << "transposition table: "
+            << probes << " probes, "
+            << hits << " hits (" << std::setprecision(2)
+            << 100.0 * hits / std::max(probes, 1) << "%), "
+            << m_tt_evals.load() << " playouts saved"
+            << std::endl;
+
+    const auto cache = m_evaluator ? m_evaluator->get_cache() : nullptr;
+    if (cache) {
+        const auto cache_probes = cache->get_probes();
+        const auto cache_hits = cache->get_hits();
+        out << "eval cache: "
+                << cache_probes << " probes, "
+                << cache_hits << " hits (" << std::setprecision(2)
+                << 100.0 * cache_hits / std::max(cache_probes, std::uint64_t{1}) << "%), "
+                << cache->get_num_entries() << " entries"
+                << (cache->get_symmetry() ? ", symmetry" : "")
+                << std::endl;
+    }
+
+    std::cerr << out.str();
+}
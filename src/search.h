@@ -0,0 +1,243 @@
+#ifndef SEARCH_H_INCLUDE
+#define SEARCH_H_INCLUDE
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include "game_state.h"
+#include "transposition.h"
+
+class BatchEvaluator;
+
+// The Monte Carlo tree search with UCT. The leaf nodes are evaluated by
+// the random playouts, or by the transposition table if the position was
+// already played out enough times, or by the network if an evaluator is
+// set. The worker threads descend the shared
+// tree at the same time. The node statistics are atomics and the virtual
+// loss keeps the threads on different branches.
+class Search {
+public:
+    // The playouts limit if no other limit is set, neither by the setters
+    // nor by the time limit of think().
+    static constexpr int DEFAULT_PLAYOUTS = 1600;
+
+    Search();
+    ~Search();
+
+    // Search the current position for the color and return the best
+    // move. The time limit, if not zero, overrides the thinking time of
+    // this move. The game state is not changed.
+    int think(GameState &state, int color, double time_limit = 0.0);
+
+    // Start to search the current position in the background until
+    // stop_ponder() is called. The tree is kept, so the next think()
+    // reuses it if the game follows it.
+    void start_ponder(GameState &state);
+
+    // Stop the background search and wait for it.
+    void stop_ponder();
+
+    // Set the maximum playouts per search. Zero means no limit. It is
+    // zero by default, so a time limit is not cut short by the playouts
+    // unless they are set.
+    void set_playouts(int playouts);
+
+    // Set the maximum visits of root node. Zero means no limit.
+    void set_visits(int visits);
+
+    // Set the maximum thinking time in seconds. Zero means no limit.
+    void set_time(double seconds);
+
+    // Set the maximum number of tree nodes. It reallocates the arena.
+    void set_max_nodes(int max_nodes);
+
+    // Set the number of search threads.
+    void set_threads(int threads);
+
+    // Dump the search results to stderr after each search or not.
+    void set_verbose(bool verbose);
+
+    // Set the memory budget of transposition table in megabytes. It
+    // drops all entries.
+    void set_tt_size(int megabytes);
+
+    // Drop all entries of transposition table.
+    void clear_tt();
+
+    // Drop the search tree, so the next search does not reuse it. It
+    // stops the pondering first.
+    void clear_tree();
+
+    // Evaluate the leaves with the network value instead of the random
+    // playouts. The evaluator could be shared with other searches, the
+    // more threads wait on it, the larger the batches. Null turns it off.
+    void set_evaluator(BatchEvaluator *evaluator);
+
+    // Use the transposition table shared with other searches. The
+    // entries are keyed by the position and komi, so the searches of
+    // different games could share it. The owner of the table starts its
+    // new generations, the search does not.
+    void set_tt(std::shared_ptr<TranspositionTable> tt);
+
+    int get_playouts() const;
+    int get_visits() const;
+    double get_time() const;
+    int get_max_nodes() const;
+    int get_threads() const;
+
+    // The playouts and seconds of the last search.
+    int get_last_playouts() const;
+    double get_last_elapsed() const;
+
+private:
+    static constexpr std::uint32_t NULL_NODE = 0xffffffff;
+
+    // The visits added to a node while a thread is searching under it.
+    static constexpr int VIRTUAL_LOSS = 3;
+
+    // The value of a win. A loss is zero and a draw is half of it.
+    static constexpr int WIN_VALUE = 1024;
+
+    // The transposition table evaluates a leaf instead of the playout if
+    // the position has at least these playouts. A leaf of the position
+    // with n playouts still runs its playout with the chance
+    // TT_MIN_VISITS / n, so the mean keeps improving.
+    static constexpr int TT_MIN_VISITS = 4;
+
+    enum expand_t : std::uint8_t {
+        UNEXPANDED = 0,
+        EXPANDING = 1,
+        EXPANDED = 2
+    };
+
+    struct Node {
+        // The move which leads to this node.
+        std::int16_t vtx;
+
+        // The number of children. They are stored contiguously in the
+        // arena, starting from first_child. Both are written before the
+        // node becomes EXPANDED.
+        std::uint16_t num_children;
+
+        std::uint32_t first_child;
+
+        std::atomic<std::uint8_t> expand_state;
+
+        std::atomic<std::int32_t> visits;
+
+        std::atomic<std::int32_t> virtual_loss;
+
+        // The sum of results in WIN_VALUE units, from the view of the
+        // player who played the move.
+        std::atomic<std::int64_t> wins;
+    };
+
+    // Initialize the node in the arena.
+    void init_node(std::uint32_t node, int vtx);
+
+    // Allocate the contiguous nodes from the arena. Return NULL_NODE if
+    // the arena is full.
+    std::uint32_t allocate_nodes(int size);
+
+    // Create the root node and clear the arena.
+    void reset_tree();
+
+    // Set the root for the state. Reuse the subtree of the previous
+    // search if the state follows it, or create a new tree.
+    void prepare_root(GameState &state);
+
+    // Run the search threads until it should stop. The running flag
+    // should be set before.
+    void run_search(GameState state);
+
+    // Create the children of node with the legal moves of state. Only
+    // one thread could expand the node, the others return immediately.
+    void expand(std::uint32_t node, GameState &state);
+
+    // Select the best child with UCT.
+    std::uint32_t select_child(std::uint32_t node) const;
+
+    // Run one simulation from the root. The state is restored after it.
+    void play_simulation(GameState &state);
+
+    // The search loop of one thread.
+    void worker(GameState state);
+
+    // Return true if the search should stop.
+    bool stop_thinking(int playouts, double elapsed) const;
+
+    // Get the best move of root.
+    int get_best_move() const;
+
+    // Dump the search results of root to stderr.
+    void dump_stats(GameState &state, int playouts, double elapsed) const;
+
+    std::unique_ptr<Node[]> m_arena;
+
+    std::uint32_t m_arena_size;
+
+    std::atomic<std::uint32_t> m_arena_used;
+
+    std::uint32_t m_root;
+
+    std::atomic<int> m_running_playouts;
+
+    // The number of leaves evaluated by the transposition table.
+    std::atomic<int> m_tt_evals;
+
+    // The transposition table probes and hits of the current search. The
+    // counters of a shared table mix all searches.
+    std::atomic<int> m_tt_probes;
+
+    std::atomic<int> m_tt_hits;
+
+    std::shared_ptr<TranspositionTable> m_tt;
+
+    // True if the table comes from set_tt().
+    bool m_shared_tt;
+
+    BatchEvaluator *m_evaluator;
+
+    std::atomic<bool> m_running;
+
+    // True if it is pondering, only stop_ponder() ends the search.
+    bool m_pondering;
+
+    std::thread m_ponder_thread;
+
+    // The time limit of the current search.
+    double m_time_limit;
+
+    // The position hash with the komi key and move number of root, for
+    // the tree reuse.
+    std::uint64_t m_root_hash;
+
+    int m_root_movenum;
+
+    // The visits of root which come from the previous search.
+    int m_reused_visits;
+
+    std::chrono::steady_clock::time_point m_start_time;
+
+    int m_playouts;
+
+    int m_visits;
+
+    double m_time;
+
+    float m_uct_c;
+
+    int m_threads;
+
+    bool m_verbose;
+
+    int m_last_playouts;
+
+    double m_last_elapsed;
+};
+
+#endif
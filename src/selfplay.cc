@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "selfplay.h"
+#include "search.h"
+#include "sgf.h"
+
+using Clock = std::chrono::steady_clock;
+
+SelfPlay::SelfPlay() {
+    m_queue_head.store(nullptr);
+    m_next_game.store(0);
+    m_running_workers.store(0);
+    m_moves.store(0);
+    m_games = 1;
+    m_threads = 1;
+    m_board_size = std::min(9, Board::BOARD_SIZE);
+    m_komi = 7.f;
+    m_generator = RANDOM_GENERATOR;
+    m_playouts = 100;
+    m_evaluator = nullptr;
+    m_last_elapsed = 0.0;
+}
+
+void SelfPlay::set_games(int games) {
+    m_games = std::max(games, 0);
+}
+
+void SelfPlay::set_threads(int threads) {
+    m_threads = std::max(threads, 1);
+}
+
+void SelfPlay::set_board_size(int board_size) {
+    m_board_size = std::min(std::max(board_size, 2), Board::BOARD_SIZE);
+}
+
+void SelfPlay::set_komi(float komi) {
+    m_komi = komi;
+}
+
+bool SelfPlay::set_generator(const std::string &name) {
+    if (name == "random") {
+        m_generator = RANDOM_GENERATOR;
+    } else if (name == "playout") {
+        m_generator = PLAYOUT_GENERATOR;
+    } else if (name == "search") {
+        m_generator = SEARCH_GENERATOR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void SelfPlay::set_playouts(int playouts) {
+    m_playouts = std::max(playouts, 1);
+}
+
+void SelfPlay::set_evaluator(BatchEvaluator *evaluator) {
+    m_evaluator = evaluator;
+}
+
+long long SelfPlay::get_last_moves() const {
+    return m_moves.load();
+}
+
+double SelfPlay::get_last_elapsed() const {
+    return m_last_elapsed;
+}
+
+void SelfPlay::push_record(Record *record) {
+    record->next = m_queue_head.load(std::memory_order_relaxed);
+    while (!m_queue_head.compare_exchange_weak(record->next, record,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed)) {}
+}
+
+SelfPlay::Record *SelfPlay::pop_records() {
+    Record *list = m_queue_head.exchange(nullptr, std::memory_order_acquire);
+
+    // The queue is a stack, reverse it to the pushed order.
+    Record *reversed = nullptr;
+    while (list) {
+        Record *next = list->next;
+        list->next = reversed;
+        reversed = list;
+        list = next;
+    }
+    return reversed;
+}
+
+int SelfPlay::playout_move(GameState &state, int color) {
+    std::vector<int> moves = state.board.legal_moves(color);
+    moves.erase(
+        std::remove_if(std::begin(moves), std::end(moves),
+                       [&state, color](int vtx) {
+                           return state.board.is_eyeshape(vtx, color) ||
+                                      !state.legal_move(vtx, color);
+                       }),
+        std::end(moves));
+
+    if (moves.empty()) {
+        return Board::PASS;
+    }
+
+    // Share the playouts between the moves, at least one per move.
+    const int num_moves = moves.size();
+    std::vector<int> wins(num_moves, 0);
+    std::vector<int> visits(num_moves, 0);
+    const int playouts = std::max(m_playouts, num_moves);
+
+    for (int i = 0; i < playouts; ++i) {
+        const int idx = i % num_moves;
+        state.play_move(moves[idx], color);
+        const float score = state.random_playout();
+        state.undo_move();
+
+        if ((color == Board::BLACK && score > 0.f) ||
+                (color == Board::WHITE && score < 0.f)) {
+            wins[idx]++;
+        }
+        visits[idx]++;
+    }
+
+    int best = 0;
+    for (int i = 1; i < num_moves; ++i) {
+        // Compare wins[i]/visits[i] with wins[best]/visits[best].
+        if (wins[i] * visits[best] > wins[best] * visits[i]) {
+            best = i;
+        }
+    }
+    return moves[best];
+}
+
+void SelfPlay::play_game(GameState &state, Search *search) {
+    state.clear_board(m_board_size, m_komi);
+
+    const int max_moves = 2 * m_board_size * m_board_size;
+    while (state.get_passes() < 2 && state.get_movenum() < max_moves) {
+        const int color = state.get_tomove();
+
+        if (m_generator == RANDOM_GENERATOR) {
+            state.play_random_move(color);
+        } else if (m_generator == PLAYOUT_GENERATOR) {
+            state.play_move(playout_move(state, color), color);
+        } else {
+            const int vtx = search->think(state, color);
+            if (vtx == Board::RESIGN) {
+                break;
+            }
+            state.play_move(vtx, color);
+        }
+    }
+}
+
+void SelfPlay::worker() {
+    GameState state;
+    std::unique_ptr<Search> search;
+
+    if (m_generator == SEARCH_GENERATOR) {
+        // Every thread has a small search of its own.
+        search.reset(new Search);
+        search->set_verbose(false);
+        search->set_threads(1);
+        search->set_playouts(m_playouts);
+        search->set_max_nodes(std::min(m_playouts * (m_board_size * m_board_size + 1),
+                                           1 << 20));
+        search->set_tt_size(1);
+        search->set_evaluator(m_evaluator);
+    }
+
+    while (m_next_game.fetch_add(1) < m_games) {
+        play_game(state, search.get());
+        m_moves.fetch_add(state.get_movenum());
+
+        auto record = new Record;
+        record->sgf = sgf_game_to_string(state, state.final_score());
+        push_record(record);
+    }
+    m_running_workers.fetch_sub(1);
+}
+
+int SelfPlay::run(std::ostream &out) {
+    const auto start = Clock::now();
+
+    m_next_game.store(0);
+    m_moves.store(0);
+    m_running_workers.store(m_threads);
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < m_threads; ++i) {
+        pool.emplace_back(&SelfPlay::worker, this);
+    }
+
+    // This thread is the writer.
+    int finished = 0;
+    for (;;) {
+        const bool done = m_running_workers.load() == 0;
+        Record *record = pop_records();
+
+        while (record) {
+            out << record->sgf;
+            finished++;
+
+            Record *next = record->next;
+            delete record;
+            record = next;
+        }
+        out.flush();
+
+        if (done) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (auto &t : pool) {
+        t.join();
+    }
+    m_last_elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return finished;
+}
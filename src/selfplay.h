@@ -0,0 +1,103 @@
+#ifndef SELFPLAY_H_INCLUDE
+#define SELFPLAY_H_INCLUDE
+
+#include <atomic>
+#include <iostream>
+#include <string>
+
+#include "game_state.h"
+
+class Search;
+class BatchEvaluator;
+
+// Play many independent games at once on a pool of threads and write
+// them as SGF. Each thread has its own GameState and random generator.
+// The finished games are passed to the writer by a lock-free queue.
+class SelfPlay {
+public:
+    enum generator_t {
+        RANDOM_GENERATOR = 0,  // play_random_move()
+        PLAYOUT_GENERATOR = 1, // flat Monte Carlo, the best mean of random playouts
+        SEARCH_GENERATOR = 2   // MCTS with one thread per game
+    };
+
+    SelfPlay();
+
+    // Play the games and write them to out on the calling thread.
+    // Return the number of finished games.
+    int run(std::ostream &out);
+
+    void set_games(int games);
+
+    void set_threads(int threads);
+
+    void set_board_size(int board_size);
+
+    void set_komi(float komi);
+
+    // Set the generator from its name, random, playout or search. Return
+    // false if the name is unknown.
+    bool set_generator(const std::string &name);
+
+    // Set the playouts per move of the playout and search generators.
+    void set_playouts(int playouts);
+
+    // The search generator evaluates the leaves with the network. All
+    // games share the evaluator, so their positions are batched and
+    // cached together.
+    void set_evaluator(BatchEvaluator *evaluator);
+
+    // The moves and seconds of the last run.
+    long long get_last_moves() const;
+    double get_last_elapsed() const;
+
+private:
+    // The finished game which is waiting for the writer.
+    struct Record {
+        std::string sgf;
+        Record *next;
+    };
+
+    // Push the record to the queue. The workers could push at the same
+    // time.
+    void push_record(Record *record);
+
+    // Take all queued records in the pushed order. Only the writer calls
+    // it.
+    Record *pop_records();
+
+    // Play one game to the end.
+    void play_game(GameState &state, Search *search);
+
+    // Pick the move with the best mean of random playouts.
+    int playout_move(GameState &state, int color);
+
+    // Play the games until the game counter runs out.
+    void worker();
+
+    std::atomic<Record *> m_queue_head;
+
+    std::atomic<int> m_next_game;
+
+    std::atomic<int> m_running_workers;
+
+    std::atomic<long long> m_moves;
+
+    int m_games;
+
+    int m_threads;
+
+    int m_board_size;
+
+    float m_komi;
+
+    int m_generator;
+
+    int m_playouts;
+
+    BatchEvaluator *m_evaluator;
+
+    double m_last_elapsed;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "server.h"
+#include "gtp.h"
+#include "search.h"
+#include "transposition.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+constexpr int GtpServer::MAX_LINE_SIZE;
+constexpr int GtpServer::MAX_SESSION_ID_SIZE;
+constexpr int GtpServer::MAX_PENDING_LINES;
+constexpr int GtpServer::MAX_MOVES;
+constexpr int GtpServer::TT_GENERATION_SECONDS;
+
+GtpServer::Connection::~Connection() {
+#ifndef _WIN32
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+GtpServer::GtpServer(int workers, int max_sessions, BatchEvaluator *evaluator) {
+    m_max_sessions = std::max(max_sessions, 1);
+    m_tt = std::make_shared<TranspositionTable>();
+    m_tt_generation_start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < std::max(workers, 1); ++i) {
+        auto search = std::unique_ptr<Search>(new Search);
+        search->set_verbose(false);
+        search->set_threads(1);
+        search->set_tt(m_tt);
+        search->set_evaluator(evaluator);
+        m_searches.emplace_back(std::move(search));
+    }
+    for (auto &search : m_searches) {
+        m_workers.emplace_back(&GtpServer::worker, this, search.get());
+    }
+}
+
+GtpServer::~GtpServer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_ready_cv.notify_all();
+
+    for (auto &t : m_workers) {
+        t.join();
+    }
+}
+
+void GtpServer::submit(const std::string &line, const std::shared_ptr<Connection> &connection) {
+    // The first token is the session id.
+    const auto begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return;
+    }
+    const auto end = std::min(line.find_first_of(" \t\r", begin), line.size());
+    const auto id = line.substr(begin, end - begin);
+
+    const char *error = nullptr;
+    if (line.size() > MAX_LINE_SIZE) {
+        error = "line too long";
+    } else if (id.size() > MAX_SESSION_ID_SIZE) {
+        error = "session id too long";
+    } else {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_sessions.find(id);
+        if (it == std::end(m_sessions)) {
+            if (static_cast<int>(m_sessions.size()) >= m_max_sessions) {
+                error = "too many sessions";
+            } else {
+                auto session = std::make_shared<Session>();
+                session->id = id;
+                session->serial = m_next_serial++;
+                session->gtp.reset(new GtpSession(MAX_MOVES));
+                it = m_sessions.emplace(id, session).first;
+            }
+        }
+
+        if (!error) {
+            auto &session = it->second;
+            if (static_cast<int>(session->pending.size()) >= MAX_PENDING_LINES) {
+                error = "session busy";
+            } else {
+                session->pending.push_back({line.substr(end), connection});
+                m_jobs++;
+                if (!session->scheduled) {
+                    session->scheduled = true;
+                    m_ready.emplace_back(session);
+                    m_ready_cv.notify_one();
+                }
+            }
+        }
+    }
+
+    if (error) {
+        write(*connection, id, std::string("? ") + error + "\n\n");
+    }
+}
+
+void GtpServer::write(Connection &connection, const std::string &id, const std::string &response) {
+    std::string output;
+    output.reserve(id.size() + 1 + response.size());
+    output += id;
+    output += ' ';
+    output += response;
+
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    if (connection.fd < 0) {
+        std::cout.write(output.data(), output.size());
+        std::cout.flush();
+        return;
+    }
+#ifndef _WIN32
+    std::size_t sent = 0;
+    while (sent < output.size()) {
+        const auto size = send(connection.fd, output.data() + sent,
+                                   output.size() - sent, MSG_NOSIGNAL);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            // The client is gone, drop the response.
+            break;
+        }
+        sent += size;
+    }
+#endif
+}
+
+void GtpServer::worker(Search *search) {
+    // The serial of the session whose tree the search holds, zero for
+    // none. The tree of another game is never reused, even if the
+    // position is the same.
+    std::uint64_t last_serial = 0;
+
+    for (;;) {
+        std::shared_ptr<Session> session;
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready_cv.wait(lock, [this]() { return m_stop || !m_ready.empty(); });
+            if (m_ready.empty()) {
+                return;
+            }
+            session = m_ready.front();
+            m_ready.pop_front();
+            job = std::move(session->pending.front());
+            session->pending.pop_front();
+        }
+
+        // Only this worker runs the session now.
+        if (session->serial != last_serial) {
+            search->clear_tree();
+            last_serial = session->serial;
+        }
+        const auto response = session->gtp->execute(job.inputs, search);
+        if (response) {
+            write(*job.connection, session->id, *response);
+        }
+
+        std::deque<Job> dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs--;
+
+            if (session->gtp->is_quit()) {
+                dropped.swap(session->pending);
+                m_jobs -= dropped.size();
+
+                auto it = m_sessions.find(session->id);
+                if (it != std::end(m_sessions) && it->second == session) {
+                    m_sessions.erase(it);
+                }
+            } else if (!session->pending.empty()) {
+                // Go to the back, so the busy sessions take turns.
+                m_ready.emplace_back(session);
+                m_ready_cv.notify_one();
+            } else {
+                session->scheduled = false;
+            }
+
+            if (m_jobs == 0) {
+                m_idle_cv.notify_all();
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (now - m_tt_generation_start >= std::chrono::seconds(TT_GENERATION_SECONDS)) {
+                m_tt->new_search();
+                m_tt_generation_start = now;
+            }
+        }
+
+        for (auto &j : dropped) {
+            write(*j.connection, session->id, "? session closed\n\n");
+        }
+    }
+}
+
+void GtpServer::wait_idle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cv.wait(lock, [this]() { return m_jobs == 0; });
+}
+
+void GtpServer::serve_stdin() {
+    auto connection = std::make_shared<Connection>();
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        submit(line, connection);
+    }
+    wait_idle();
+}
+
+void GtpServer::read_connection(std::shared_ptr<Connection> connection) {
+#ifndef _WIN32
+    char buf[4096];
+    std::string line;
+
+    for (;;) {
+        const auto size = recv(connection->fd, buf, sizeof(buf), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            break;
+        }
+        for (int i = 0; i < size; ++i) {
+            if (buf[i] == '\n') {
+                submit(line, connection);
+                line.clear();
+            } else if (line.size() <= MAX_LINE_SIZE) {
+                // Keep one more char, so submit() sees the long line.
+                line += buf[i];
+            }
+        }
+    }
+#else
+    (void) connection;
+#endif
+}
+
+bool GtpServer::serve_socket(const std::string &path) {
+#ifndef _WIN32
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+            listen(fd, 64) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    for (;;) {
+        const int client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        auto connection = std::make_shared<Connection>();
+        connection->fd = client;
+        std::thread(&GtpServer::read_connection, this, connection).detach();
+    }
+    ::close(fd);
+    return true;
+#else
+    (void) path;
+    return false;
+#endif
+}
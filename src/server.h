@@ -0,0 +1,136 @@
+#ifndef SERVER_H_INCLUDE
+#define SERVER_H_INCLUDE
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "board.h"
+
+class Search;
+class GtpSession;
+class TranspositionTable;
+class BatchEvaluator;
+
+// Serve many independent GTP sessions in one process. Every input line
+// starts with the session id, like "game1 genmove b", and the response
+// starts with the same id. A session is created by its first line and
+// removed by quit, the lines queued after quit are dropped. The sessions share a pool of workers, each with its
+// own search tree, and one transposition table. A session only keeps its
+// game, and the moves, queued lines and line size are limited, so the
+// memory of a session is bounded.
+class GtpServer {
+public:
+    // If the evaluator is given, all workers use it, so the leaves of
+    // the sessions are batched together.
+    GtpServer(int workers, int max_sessions, BatchEvaluator *evaluator = nullptr);
+    ~GtpServer();
+
+    // Serve the lines of stdin until the end of inputs.
+    void serve_stdin();
+
+    // Serve the connections of the Unix socket at the path. Any
+    // connection could use any session. Return false if it could not
+    // listen.
+    bool serve_socket(const std::string &path);
+
+private:
+    static constexpr int MAX_LINE_SIZE = 4096;
+
+    static constexpr int MAX_SESSION_ID_SIZE = 64;
+
+    // The queued lines per session.
+    static constexpr int MAX_PENDING_LINES = 64;
+
+    // The moves per session game.
+    static constexpr int MAX_MOVES = 4 * Board::NUM_INTESECTIONS;
+
+    // The seconds between the generations of the shared transposition
+    // table, so the entries age by the time and not by the number of
+    // searches of all sessions.
+    static constexpr int TT_GENERATION_SECONDS = 10;
+
+    // Where the responses go, stdout or one socket connection.
+    struct Connection {
+        ~Connection();
+
+        // The socket, or -1 for stdout.
+        int fd{-1};
+
+        std::mutex mutex;
+    };
+
+    struct Job {
+        std::string inputs;
+        std::shared_ptr<Connection> connection;
+    };
+
+    struct Session {
+        std::string id;
+
+        // The unique number of the session. The ids could be reused after
+        // quit, so the workers tell the sessions apart by it.
+        std::uint64_t serial;
+
+        std::unique_ptr<GtpSession> gtp;
+        std::deque<Job> pending;
+
+        // True if it is in the ready queue or a worker runs it, so only
+        // one worker runs the session at a time.
+        bool scheduled{false};
+    };
+
+    // Queue the input line of the connection to its session.
+    void submit(const std::string &line, const std::shared_ptr<Connection> &connection);
+
+    // Write the response of the session with a single write.
+    void write(Connection &connection, const std::string &id, const std::string &response);
+
+    // Run the queued lines of the ready sessions with the search.
+    void worker(Search *search);
+
+    // Read the lines of one socket connection.
+    void read_connection(std::shared_ptr<Connection> connection);
+
+    // Wait until no line is queued or running.
+    void wait_idle();
+
+    std::shared_ptr<TranspositionTable> m_tt;
+
+    // When the last generation of the table started.
+    std::chrono::steady_clock::time_point m_tt_generation_start;
+
+    std::vector<std::unique_ptr<Search>> m_searches;
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_ready_cv;
+
+    std::condition_variable m_idle_cv;
+
+    std::unordered_map<std::string, std::shared_ptr<Session>> m_sessions;
+
+    // The sessions which have queued lines.
+    std::deque<std::shared_ptr<Session>> m_ready;
+
+    // The lines queued or running.
+    int m_jobs{0};
+
+    // The serial of the next new session, starting from 1.
+    std::uint64_t m_next_serial{1};
+
+    bool m_stop{false};
+
+    int m_max_sessions;
+};
+
+#endif
@@ -0,0 +1,399 @@
+#include "sgf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+void SgfParser::split_games(const char *data, std::size_t size,
+                                std::vector<SgfGame> &games) {
+    games.clear();
+
+    int depth = 0;
+    std::size_t start = 0;
+
+    for (std::size_t i = 0; i < size; ++i) {
+        const char c = data[i];
+        if (c == '(') {
+            if (depth++ == 0) start = i;
+        } else if (c == ')') {
+            if (depth > 0 && --depth == 0) {
+                games.push_back({start, i+1});
+            }
+        } else if (c == '[' && depth > 0) {
+            // Skip the value, it may have any brackets.
+            for (++i; i < size && data[i] != ']'; ++i) {
+                if (data[i] == '\\') ++i;
+            }
+        }
+    }
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static const char *skip_space(const char *p, const char *end) {
+    while (p != end && is_space(*p)) ++p;
+    return p;
+}
+
+// Parse the properties of one node, starting after the ';'. The visitor
+// is called with the property identifier and every value without the
+// brackets, and returns false to stop. Return the pointer to the next
+// node or game tree, or nullptr if the node is broken or stopped.
+template<typename Visitor>
+static const char *parse_node(const char *p, const char *end, Visitor visit) {
+    for (;;) {
+        p = skip_space(p, end);
+        if (p == end) {
+            return nullptr;
+        }
+        if (*p == ';' || *p == '(' || *p == ')') {
+            return p;
+        }
+
+        // The lowercase letters of old FF[3] identifiers are ignored.
+        char ident[4] = {0};
+        int ident_size = 0;
+        while (p != end && std::isalpha(static_cast<unsigned char>(*p))) {
+            if (std::isupper(static_cast<unsigned char>(*p)) && ident_size < 3) {
+                ident[ident_size++] = *p;
+            }
+            ++p;
+        }
+        p = skip_space(p, end);
+        if (ident_size == 0 || p == end || *p != '[') {
+            return nullptr;
+        }
+
+        while (p != end && *p == '[') {
+            const char *value = ++p;
+            while (p != end && *p != ']') {
+                if (*p == '\\' && ++p == end) break;
+                ++p;
+            }
+            if (p == end) {
+                return nullptr;
+            }
+            if (!visit(ident, value, p)) {
+                return nullptr;
+            }
+            p = skip_space(p+1, end);
+        }
+    }
+}
+
+static bool is_property(const char *ident, const char *name) {
+    return std::strcmp(ident, name) == 0;
+}
+
+// Return the SGF coordinate of the char, or -1 if it is invalid.
+static int sgf_coord(char c) {
+    if (c >= 'a' && c <= 'z') return c - 'a';
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 26;
+    return -1;
+}
+
+// Convert the SGF point to the vertex. The empty value and "tt" on the
+// small boards are pass. Return NULL_VERTEX if it is invalid.
+static int sgf_to_vertex(const GameState &state, const char *value, const char *end) {
+    const int board_size = state.get_board_size();
+    const auto size = end - value;
+
+    if (size == 0) {
+        return Board::PASS;
+    }
+    if (size != 2) {
+        return Board::NULL_VERTEX;
+    }
+
+    const int x = sgf_coord(value[0]);
+    const int y = sgf_coord(value[1]);
+    if (board_size <= 19 && x == 19 && y == 19) {
+        return Board::PASS;
+    }
+    if (x < 0 || x >= board_size || y < 0 || y >= board_size) {
+        return Board::NULL_VERTEX;
+    }
+    // The first SGF row is the top row.
+    return state.get_vertex(x, board_size - 1 - y);
+}
+
+// Place the setup stones of one value, a point or a rectangle "aa:cc".
+// The EMPTY color clears the points.
+static bool add_setup_stones(GameState &state, int color,
+                                 const char *value, const char *end) {
+    const char *colon = std::find(value, end, ':');
+    const int from = sgf_to_vertex(state, value, colon);
+    const int to = colon == end ? from : sgf_to_vertex(state, colon+1, end);
+
+    if (from == Board::NULL_VERTEX || from == Board::PASS ||
+            to == Board::NULL_VERTEX || to == Board::PASS) {
+        return false;
+    }
+
+    const int x0 = std::min(state.get_x(from), state.get_x(to));
+    const int x1 = std::max(state.get_x(from), state.get_x(to));
+    const int y0 = std::min(state.get_y(from), state.get_y(to));
+    const int y1 = std::max(state.get_y(from), state.get_y(to));
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            if (!state.set_setup_stone(state.get_vertex(x, y), color)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Parse the RE property value to the black score.
+static float parse_result(const char *value, const char *end) {
+    if (end - value >= 2 && value[1] == '+' &&
+            (value[0] == 'B' || value[0] == 'W')) {
+        const float sign = value[0] == 'B' ? 1.f : -1.f;
+        char *score_end;
+        const float score = std::strtof(value+2, &score_end);
+        if (score_end != value+2 && score_end <= end) {
+            return sign * score;
+        }
+        // Resign, time or forfeit.
+        return sign * std::numeric_limits<float>::infinity();
+    }
+    if ((end - value == 1 && value[0] == '0') ||
+            (end - value >= 1 && (value[0] == 'D' || value[0] == 'J'))) {
+        // Draw or jigo.
+        return 0.f;
+    }
+    return std::numeric_limits<float>::quiet_NaN();
+}
+
+int SgfParser::load_game(const char *begin, const char *end,
+                             GameState &state, int max_moves, float *result) {
+    const char *p = skip_space(begin, end);
+    if (p == end || *p != '(') {
+        return -1;
+    }
+    p = skip_space(p+1, end);
+    if (p == end || *p != ';') {
+        return -1;
+    }
+    const char *root = p+1;
+
+    // The board size and komi should be known before any stone.
+    int board_size = 19;
+    float komi = 0.f;
+    float score = std::numeric_limits<float>::quiet_NaN();
+    p = parse_node(root, end,
+            [&](const char *ident, const char *value, const char *value_end) {
+                if (is_property(ident, "SZ")) {
+                    board_size = std::atoi(value);
+                } else if (is_property(ident, "KM")) {
+                    komi = std::strtof(value, nullptr);
+                } else if (is_property(ident, "RE")) {
+                    score = parse_result(value, value_end);
+                }
+                return true;
+            });
+    if (!p || board_size < 2 || board_size > Board::BOARD_SIZE) {
+        return -1;
+    }
+    state.clear_board(board_size, komi);
+    if (result) {
+        *result = score;
+    }
+
+    int moves = 0;
+    int to_move = Board::INVLD;
+    bool setup = false;
+
+    const auto play = [&](const char *ident, const char *value, const char *value_end) {
+        if (is_property(ident, "B") || is_property(ident, "W")) {
+            const int color = ident[0] == 'B' ? Board::BLACK : Board::WHITE;
+            const int vtx = sgf_to_vertex(state, value, value_end);
+            if (vtx == Board::NULL_VERTEX || !state.play_move(vtx, color)) {
+                return false;
+            }
+            moves++;
+            to_move = Board::INVLD;
+        } else if (is_property(ident, "AB") || is_property(ident, "AW")) {
+            const int color = ident[1] == 'B' ? Board::BLACK : Board::WHITE;
+            if (!add_setup_stones(state, color, value, value_end)) {
+                return false;
+            }
+            // The handicap stones are followed by white.
+            setup = true;
+            to_move = color == Board::BLACK ? Board::WHITE : Board::BLACK;
+        } else if (is_property(ident, "AE")) {
+            if (!add_setup_stones(state, Board::EMPTY, value, value_end)) {
+                return false;
+            }
+        } else if (is_property(ident, "PL")) {
+            to_move = (value != value_end && (*value == 'W' || *value == 'w')) ?
+                          Board::WHITE : Board::BLACK;
+            setup = true;
+        }
+        return true;
+    };
+
+    p = parse_node(root, end, play);
+    while (p) {
+        if (setup) {
+            if (to_move != Board::INVLD) {
+                state.set_to_move(to_move);
+            }
+            setup = false;
+        }
+
+        p = skip_space(p, end);
+        if (p == end) {
+            break;
+        }
+
+        const char c = *p++;
+        if (c == ';') {
+            if (max_moves >= 0 && moves >= max_moves) {
+                return moves;
+            }
+            p = parse_node(p, end, play);
+        } else if (c == ')') {
+            // The end of the main line.
+            return moves;
+        } else if (c != '(') {
+            break;
+        }
+        // Follow the first variation.
+    }
+    return -1;
+}
+
+bool sgf_replay_file(const std::string &filename, int threads,
+                         SgfReplayStats &stats,
+                         const std::function<void(int, const GameState &, float)> &callback) {
+    const auto start = std::chrono::steady_clock::now();
+
+    stats.games = 0;
+    stats.failed = 0;
+    stats.moves = 0;
+    stats.seconds = 0.0;
+
+    // The games are split in one forward pass.
+    MappedFile file;
+    if (!file.open(filename, true)) {
+        return false;
+    }
+
+    std::vector<SgfGame> games;
+    SgfParser::split_games(file.data(), file.size(), games);
+
+    std::atomic<int> next{0};
+    std::atomic<int> replayed{0};
+    std::atomic<int> failed{0};
+    std::atomic<long long> moves{0};
+
+    const auto worker = [&]() {
+        GameState state;
+        for (;;) {
+            const int idx = next.fetch_add(1);
+            if (idx >= static_cast<int>(games.size())) {
+                break;
+            }
+            const auto &game = games[idx];
+            float result;
+            const int num_moves = SgfParser::load_game(file.data() + game.begin,
+                                                           file.data() + game.end,
+                                                           state, -1, &result);
+            if (num_moves < 0) {
+                failed.fetch_add(1);
+                continue;
+            }
+            replayed.fetch_add(1);
+            moves.fetch_add(num_moves);
+            if (callback) {
+                callback(idx, state, result);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : pool) {
+        t.join();
+    }
+
+    stats.games = replayed.load();
+    stats.failed = failed.load();
+    stats.moves = moves.load();
+    stats.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// Append the SGF point of the vertex, nothing for pass.
+static void append_sgf_point(std::string &out, const GameState &state, int vtx) {
+    if (vtx != Board::PASS) {
+        // The first SGF row is the top row.
+        out += static_cast<char>('a' + state.get_x(vtx));
+        out += static_cast<char>('a' + state.get_board_size() - 1 - state.get_y(vtx));
+    }
+}
+
+std::string sgf_game_to_string(const GameState &state, float score) {
+    const int board_size = state.get_board_size();
+    std::string out;
+    char buf[64];
+
+    std::snprintf(buf, sizeof(buf), "(;GM[1]FF[4]SZ[%d]KM[%g]RE[",
+                      board_size, state.get_komi());
+    out += buf;
+    if (std::abs(score) < 0.001f) {
+        out += "0";
+    } else {
+        std::snprintf(buf, sizeof(buf), "%c+%g",
+                          score > 0.f ? 'B' : 'W', std::abs(score));
+        out += buf;
+    }
+    out += "]";
+
+    const int movenum = state.get_movenum();
+    const auto &setup_stones = state.get_setup_stones();
+    if (!setup_stones.empty()) {
+        for (const int color : {Board::BLACK, Board::WHITE}) {
+            bool first = true;
+            for (const auto &stone : setup_stones) {
+                if (stone.second != color) {
+                    continue;
+                }
+                if (first) {
+                    out += color == Board::BLACK ? "AB" : "AW";
+                    first = false;
+                }
+                out += '[';
+                append_sgf_point(out, state, stone.first);
+                out += ']';
+            }
+        }
+        // The side to move after the setup.
+        const int tomove = movenum > 0 ? state.get_move_color(1) : state.get_tomove();
+        out += tomove == Board::BLACK ? "PL[B]" : "PL[W]";
+    }
+    out += "\n";
+
+    for (int i = 1; i <= movenum; ++i) {
+        out += state.get_move_color(i) == Board::BLACK ? ";B[" : ";W[";
+        append_sgf_point(out, state, state.get_move(i));
+        out += ']';
+    }
+    out += ")\n";
+    return out;
+}
@@ -0,0 +1,59 @@
+#ifndef SGF_H_INCLUDE
+#define SGF_H_INCLUDE
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "game_state.h"
+#include "mapped_file.h"
+
+// The byte range [begin, end) of one game tree in the file.
+struct SgfGame {
+    std::size_t begin;
+    std::size_t end;
+};
+
+class SgfParser {
+public:
+    // Find the top level game trees of a collection.
+    static void split_games(const char *data, std::size_t size,
+                                std::vector<SgfGame> &games);
+
+    // Replay the main line of one game tree into the state. It stops
+    // after max_moves moves if max_moves is not negative. The setup
+    // stones (AB/AW) are placed by GameState::set_setup_stone() without
+    // playing them, and AE clears the points. They are not moves, so
+    // they are allowed only before the first move. Return the number of
+    // replayed moves, or -1 if the game is broken, larger than the board
+    // or has an illegal move or setup. The property values are read in
+    // place, so it allocates nothing but the state itself. If result is
+    // not null, it is set to the black score of RE property, +/-infinity
+    // if only the winner is known (like B+R), zero for a draw and NaN if
+    // there is no result.
+    static int load_game(const char *begin, const char *end,
+                             GameState &state, int max_moves = -1,
+                             float *result = nullptr);
+};
+
+struct SgfReplayStats {
+    int games;
+    int failed;
+    long long moves;
+    double seconds;
+};
+
+// Replay every game of the file on the given number of threads. Each
+// thread has its own GameState. The callback, if any, is called on the
+// worker threads with the game index, the final state and the result
+// of every replayed game. Return false if the file could not be opened.
+bool sgf_replay_file(const std::string &filename, int threads,
+                         SgfReplayStats &stats,
+                         const std::function<void(int, const GameState &, float)> &callback = nullptr);
+
+// Write the moves of the game as a SGF game tree. The score is the black
+// score for the result property.
+std::string sgf_game_to_string(const GameState &state, float score);
+
+#endif
@@ -0,0 +1,221 @@
+#include "symmetry.h"
+#include "zobrist.h"
+
+#include <algorithm>
+
+constexpr int Symmetry::NUM_SYMMETRIES;
+constexpr int Symmetry::IDENTITY;
+
+std::array<std::array<Symmetry::VertexMap, Symmetry::NUM_SYMMETRIES>, Board::BOARD_SIZE+1> Symmetry::VERTEX_MAPS;
+std::array<std::array<Symmetry::IndexMap, Symmetry::NUM_SYMMETRIES>, Board::BOARD_SIZE+1> Symmetry::INDEX_MAPS;
+std::array<int, Symmetry::NUM_SYMMETRIES> Symmetry::INVERSES;
+
+// Same as Board::get_vertex() of the board size.
+static int get_vertex(int x, int y, int board_size) {
+    return (y+1) * (board_size+2) + (x+1);
+}
+
+void Symmetry::initialize() {
+    for (int board_size = 1; board_size <= Board::BOARD_SIZE; ++board_size) {
+        for (int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+            auto &vertex_map = VERTEX_MAPS[board_size][symmetry];
+            auto &index_map = INDEX_MAPS[board_size][symmetry];
+
+            // The points off the board stay the same.
+            for (int vtx = 0; vtx < Board::NUM_VERTICES; ++vtx) {
+                vertex_map[vtx] = vtx;
+            }
+            for (int y = 0; y < board_size; ++y) {
+                for (int x = 0; x < board_size; ++x) {
+                    int sx = x;
+                    int sy = y;
+                    if (symmetry & 4) {
+                        std::swap(sx, sy);
+                    }
+                    if (symmetry & 1) {
+                        sx = board_size - 1 - sx;
+                    }
+                    if (symmetry & 2) {
+                        sy = board_size - 1 - sy;
+                    }
+                    vertex_map[get_vertex(x, y, board_size)] = get_vertex(sx, sy, board_size);
+                    index_map[y * board_size + x] = sy * board_size + sx;
+                }
+            }
+        }
+    }
+
+    // Find the inverses on the largest board.
+    const auto &maps = VERTEX_MAPS[Board::BOARD_SIZE];
+    for (int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        for (int inverse = 0; inverse < NUM_SYMMETRIES; ++inverse) {
+            bool identity = true;
+            for (int vtx = 0; vtx < Board::NUM_VERTICES; ++vtx) {
+                identity &= maps[inverse][maps[symmetry][vtx]] == vtx;
+            }
+            if (identity) {
+                INVERSES[symmetry] = inverse;
+            }
+        }
+    }
+}
+
+int Symmetry::get_inverse(int symmetry) {
+    return INVERSES[symmetry];
+}
+
+int Symmetry::transform_vertex(int symmetry, int vtx, int board_size) {
+    if (vtx < 0 || vtx >= Board::NUM_VERTICES) {
+        return vtx;
+    }
+    return VERTEX_MAPS[board_size][symmetry][vtx];
+}
+
+int Symmetry::transform_index(int symmetry, int idx, int board_size) {
+    return INDEX_MAPS[board_size][symmetry][idx];
+}
+
+void Symmetry::transform_planes(int symmetry, int board_size, int channels,
+                                    const float *planes, float *output) {
+    const int num_intersections = board_size * board_size;
+    const auto &map = INDEX_MAPS[board_size][symmetry];
+
+    for (int c = 0; c < channels; ++c) {
+        const float *in = planes + c * num_intersections;
+        float *out = output + c * num_intersections;
+        for (int idx = 0; idx < num_intersections; ++idx) {
+            out[map[idx]] = in[idx];
+        }
+    }
+}
+
+void Symmetry::transform_board(int symmetry, const Board &board, Board &output) {
+    const int board_size = board.get_board_size();
+    const auto &map = VERTEX_MAPS[board_size][symmetry];
+
+    output.reset_board(board_size);
+    for (int y = 0; y < board_size; ++y) {
+        for (int x = 0; x < board_size; ++x) {
+            const int vtx = board.get_vertex(x, y);
+            const int state = board.get_state(vtx);
+            if (state == Board::BLACK || state == Board::WHITE) {
+                output.set_stone(map[vtx], state);
+            }
+        }
+    }
+    output.set_move_state(board.get_tomove(),
+                              transform_vertex(symmetry, board.get_komove(), board_size),
+                              transform_vertex(symmetry, board.get_last_move(), board_size),
+                              board.get_passes());
+}
+
+// The change of the hash when the stone is put on the empty point.
+static std::uint64_t get_stone_key(int color, int vtx) {
+    return Zobrist::STATE[Board::EMPTY][vtx] ^ Zobrist::STATE[color][vtx];
+}
+
+std::uint64_t Symmetry::get_hash(int symmetry, const Board &board) {
+    const int board_size = board.get_board_size();
+    const auto &map = VERTEX_MAPS[board_size][symmetry];
+
+    // Move every stone and the ko move from the point to the mapped
+    // point. The empty board and the side to move stay the same.
+    std::uint64_t hash = board.get_hash();
+    for (int y = 0; y < board_size; ++y) {
+        for (int x = 0; x < board_size; ++x) {
+            const int vtx = board.get_vertex(x, y);
+            const int state = board.get_state(vtx);
+            if (state == Board::BLACK || state == Board::WHITE) {
+                hash ^= get_stone_key(state, vtx) ^ get_stone_key(state, map[vtx]);
+            }
+        }
+    }
+    const int komove = board.get_komove();
+    if (komove != Board::NULL_VERTEX) {
+        hash ^= Zobrist::KO_MOVE[komove] ^ Zobrist::KO_MOVE[map[komove]];
+    }
+    return hash;
+}
+
+// Compute the hashes of all symmetries in one pass.
+static void get_all_hashes(const Board &board,
+                               const std::array<std::array<std::uint16_t, Board::NUM_VERTICES>,
+                                                Symmetry::NUM_SYMMETRIES> &maps,
+                               std::uint64_t *hashes) {
+    const int board_size = board.get_board_size();
+    std::fill(hashes, hashes + Symmetry::NUM_SYMMETRIES, board.get_hash());
+
+    for (int y = 0; y < board_size; ++y) {
+        for (int x = 0; x < board_size; ++x) {
+            const int vtx = board.get_vertex(x, y);
+            const int state = board.get_state(vtx);
+            if (state != Board::BLACK && state != Board::WHITE) {
+                continue;
+            }
+            const auto key = get_stone_key(state, vtx);
+            for (int s = 1; s < Symmetry::NUM_SYMMETRIES; ++s) {
+                hashes[s] ^= key ^ get_stone_key(state, maps[s][vtx]);
+            }
+        }
+    }
+    const int komove = board.get_komove();
+    if (komove != Board::NULL_VERTEX) {
+        for (int s = 1; s < Symmetry::NUM_SYMMETRIES; ++s) {
+            hashes[s] ^= Zobrist::KO_MOVE[komove] ^ Zobrist::KO_MOVE[maps[s][komove]];
+        }
+    }
+}
+
+std::uint64_t Symmetry::get_canonical_hash(const Board &board, int &symmetry) {
+    std::uint64_t hashes[NUM_SYMMETRIES];
+    get_all_hashes(board, VERTEX_MAPS[board.get_board_size()], hashes);
+
+    symmetry = IDENTITY;
+    for (int s = 1; s < NUM_SYMMETRIES; ++s) {
+        if (hashes[s] < hashes[symmetry]) {
+            symmetry = s;
+        }
+    }
+    return hashes[symmetry];
+}
+
+void Symmetry::remove_symmetric_moves(const Board &board, std::vector<int> &moves) {
+    const auto &maps = VERTEX_MAPS[board.get_board_size()];
+    std::uint64_t hashes[NUM_SYMMETRIES];
+    get_all_hashes(board, maps, hashes);
+
+    // The symmetries which keep the position.
+    int symmetries[NUM_SYMMETRIES];
+    int num_symmetries = 0;
+    for (int s = 1; s < NUM_SYMMETRIES; ++s) {
+        if (hashes[s] == hashes[IDENTITY]) {
+            symmetries[num_symmetries++] = s;
+        }
+    }
+    if (num_symmetries == 0) {
+        return;
+    }
+
+    // Keep the smallest vertex of the mapped moves in the list.
+    std::array<bool, Board::NUM_VERTICES> listed{};
+    for (const auto vtx : moves) {
+        if (vtx >= 0 && vtx < Board::NUM_VERTICES) {
+            listed[vtx] = true;
+        }
+    }
+    moves.erase(
+        std::remove_if(std::begin(moves), std::end(moves),
+                       [&](int vtx) {
+                           if (vtx < 0 || vtx >= Board::NUM_VERTICES) {
+                               return false;
+                           }
+                           for (int i = 0; i < num_symmetries; ++i) {
+                               const int sym_vtx = maps[symmetries[i]][vtx];
+                               if (sym_vtx < vtx && listed[sym_vtx]) {
+                                   return true;
+                               }
+                           }
+                           return false;
+                       }),
+        std::end(moves));
+}
@@ -0,0 +1,66 @@
+#ifndef SYMMETRY_H_INCLUDE
+#define SYMMETRY_H_INCLUDE
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "board.h"
+
+// The 8 rotations and reflections of the board. The symmetry 0 is the
+// identity, the bit 2 transposes the board, then the bit 0 flips x and
+// the bit 1 flips y. The vertex maps of every board size are
+// precomputed, so a transform is a table lookup per point.
+class Symmetry {
+public:
+    static constexpr int NUM_SYMMETRIES = 8;
+
+    static constexpr int IDENTITY = 0;
+
+    // Fill the tables. It should be called once before any transform.
+    static void initialize();
+
+    // Return the symmetry which undoes the symmetry.
+    static int get_inverse(int symmetry);
+
+    // Map the vertex. The pass, resign and null vertex stay the same.
+    static int transform_vertex(int symmetry, int vtx, int board_size);
+
+    // Map the index of the point, y * board_size + x.
+    static int transform_index(int symmetry, int idx, int board_size);
+
+    // Map every plane of the feature buffer, in [channel][point] order,
+    // to the output. The output should not be the input.
+    static void transform_planes(int symmetry, int board_size, int channels,
+                                     const float *planes, float *output);
+
+    // Set the output to the mapped position, with the stones, side to
+    // move, ko move, last move and passes. The history is not copied.
+    static void transform_board(int symmetry, const Board &board, Board &output);
+
+    // Return the hash of the mapped position. It is equal to the
+    // get_hash() of the transform_board() output.
+    static std::uint64_t get_hash(int symmetry, const Board &board);
+
+    // Return the smallest hash of the 8 mapped positions, and the
+    // symmetry which gives it. The symmetric positions have the same
+    // canonical hash. It takes one pass over the board.
+    static std::uint64_t get_canonical_hash(const Board &board, int &symmetry);
+
+    // Remove the moves which are the mapped moves of the other moves in
+    // the list by the symmetries of the position. For example, only 15
+    // of the 81 points are kept on the empty 9x9 board.
+    static void remove_symmetric_moves(const Board &board, std::vector<int> &moves);
+
+private:
+    using VertexMap = std::array<std::uint16_t, Board::NUM_VERTICES>;
+    using IndexMap = std::array<std::uint16_t, Board::NUM_INTESECTIONS>;
+
+    // The maps per board size and symmetry.
+    static std::array<std::array<VertexMap, NUM_SYMMETRIES>, Board::BOARD_SIZE+1> VERTEX_MAPS;
+    static std::array<std::array<IndexMap, NUM_SYMMETRIES>, Board::BOARD_SIZE+1> INDEX_MAPS;
+
+    static std::array<int, NUM_SYMMETRIES> INVERSES;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include <algorithm>
+
+#include "time_control.h"
+
+constexpr double TimeControl::LAG_BUFFER;
+
+TimeControl::TimeControl() {
+    set_no_limit();
+}
+
+void TimeControl::set_no_limit() {
+    m_unlimited = true;
+    m_japanese = false;
+    m_main_time = 0.0;
+    m_byo_time = 0.0;
+    m_byo_stones = 0;
+    reset_clocks();
+}
+
+void TimeControl::set_canadian(double main_time, double byo_time, int byo_stones) {
+    m_unlimited = false;
+    m_japanese = false;
+    m_main_time = std::max(main_time, 0.0);
+    m_byo_time = std::max(byo_time, 0.0);
+    m_byo_stones = std::max(byo_stones, 0);
+
+    if (m_byo_time <= 0.0 || m_byo_stones == 0) {
+        // The absolute time.
+        m_byo_time = 0.0;
+        m_byo_stones = 0;
+    }
+    reset_clocks();
+}
+
+void TimeControl::set_japanese(double main_time, double byo_time, int byo_periods) {
+    m_unlimited = false;
+    m_japanese = true;
+    m_main_time = std::max(main_time, 0.0);
+    m_byo_time = std::max(byo_time, 0.0);
+    m_byo_stones = std::max(byo_periods, 0);
+
+    if (m_byo_time <= 0.0 || m_byo_stones == 0) {
+        m_japanese = false;
+        m_byo_time = 0.0;
+        m_byo_stones = 0;
+    }
+    reset_clocks();
+}
+
+void TimeControl::reset_clocks() {
+    for (int color = 0; color < 2; ++color) {
+        m_remaining_time[color] = m_main_time;
+        m_remaining_stones[color] = 0;
+        m_in_byo[color] = false;
+
+        if (m_main_time <= 0.0 && m_byo_stones > 0) {
+            m_remaining_time[color] = m_byo_time;
+            m_remaining_stones[color] = m_byo_stones;
+            m_in_byo[color] = true;
+        }
+    }
+}
+
+void TimeControl::time_left(int color, double time, int stones) {
+    m_remaining_time[color] = time;
+    m_remaining_stones[color] = stones;
+    m_in_byo[color] = (stones > 0);
+}
+
+void TimeControl::consume(int color, double seconds) {
+    if (m_unlimited) {
+        return;
+    }
+
+    if (!m_in_byo[color]) {
+        m_remaining_time[color] -= seconds;
+        if (m_remaining_time[color] > 0.0 || m_byo_stones == 0) {
+            return;
+        }
+
+        // The main time is over, go into byo-yomi. The overtime of this
+        // move is taken from the first period.
+        seconds = -m_remaining_time[color];
+        m_in_byo[color] = true;
+        m_remaining_time[color] = m_byo_time;
+        m_remaining_stones[color] = m_byo_stones;
+    }
+
+    if (m_japanese) {
+        // Each overtime period loses one period.
+        while (seconds > m_byo_time && m_remaining_stones[color] > 1) {
+            seconds -= m_byo_time;
+            m_remaining_stones[color]--;
+        }
+        m_remaining_time[color] = m_byo_time;
+    } else {
+        m_remaining_time[color] -= seconds;
+        if (--m_remaining_stones[color] <= 0) {
+            // A new period begins.
+            m_remaining_time[color] = m_byo_time;
+            m_remaining_stones[color] = m_byo_stones;
+        }
+    }
+}
+
+double TimeControl::get_thinking_time(int color, int board_size, int movenum) const {
+    if (m_unlimited) {
+        return 0.0;
+    }
+
+    double budget;
+    const double remaining = m_remaining_time[color];
+
+    if (m_in_byo[color]) {
+        if (m_japanese) {
+            budget = remaining;
+        } else {
+            budget = remaining / std::max(m_remaining_stones[color], 1);
+        }
+    } else {
+        // Guess how many moves we still play. The game lasts about half
+        // of the board area moves per side, and keep some for the end.
+        const int board_area = board_size * board_size;
+        const int moves_left = std::max(board_area - movenum, board_area / 3) / 2;
+
+        budget = remaining / std::max(moves_left, 1);
+
+        if (m_byo_stones > 0) {
+            // The byo-yomi time is spent anyway after the main time.
+            const double byo_per_move = m_japanese ?
+                                            m_byo_time : m_byo_time / m_byo_stones;
+            budget += 0.75 * byo_per_move;
+            budget = std::min(budget, remaining + byo_per_move);
+        }
+    }
+
+    return std::max(budget - LAG_BUFFER, 0.05);
+}
+
+bool TimeControl::is_unlimited() const {
+    return m_unlimited;
+}
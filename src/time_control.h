@@ -0,0 +1,61 @@
+#ifndef TIME_CONTROL_H_INCLUDE
+#define TIME_CONTROL_H_INCLUDE
+
+// Track the game clocks of both sides and decide the thinking time per
+// move. It supports the absolute time, Canadian byo-yomi and Japanese
+// byo-yomi. All times are in seconds.
+class TimeControl {
+public:
+    TimeControl();
+
+    // No time limit. The search uses its own limits.
+    void set_no_limit();
+
+    // Set the main time and Canadian byo-yomi, byo_stones moves in every
+    // byo_time period. The absolute time has no byo-yomi.
+    void set_canadian(double main_time, double byo_time, int byo_stones);
+
+    // Set the main time and Japanese byo-yomi, byo_periods periods of
+    // byo_time.
+    void set_japanese(double main_time, double byo_time, int byo_periods);
+
+    // Reset both clocks to the main time.
+    void reset_clocks();
+
+    // Update the clock of color from GTP time_left. The stones are the
+    // moves (Canadian) or periods (Japanese) left in byo-yomi, or zero in
+    // the main time.
+    void time_left(int color, double time, int stones);
+
+    // Take the used time of one move from the clock of color.
+    void consume(int color, double seconds);
+
+    // Return the thinking time of the next move of color. Zero means no
+    // limit.
+    double get_thinking_time(int color, int board_size, int movenum) const;
+
+    bool is_unlimited() const;
+
+private:
+    // The time kept for the network and GUI lag.
+    static constexpr double LAG_BUFFER = 0.5;
+
+    bool m_unlimited;
+
+    bool m_japanese;
+
+    double m_main_time;
+
+    double m_byo_time;
+
+    // The stones per period (Canadian) or the periods (Japanese).
+    int m_byo_stones;
+
+    double m_remaining_time[2];
+
+    int m_remaining_stones[2];
+
+    bool m_in_byo[2];
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include "transposition.h"
+
+constexpr int TranspositionTable::BUCKET_SIZE;
+constexpr int TranspositionTable::GENERATION_MASK;
+constexpr int TranspositionTable::MAX_VISITS;
+
+TranspositionTable::TranspositionTable() {
+    resize(16);
+}
+
+void TranspositionTable::resize(std::size_t megabytes) {
+    const std::size_t budget = std::max(megabytes, std::size_t{1}) * 1024 * 1024;
+
+    // Use a power of two number of buckets, so the index is a mask.
+    std::size_t size = 1;
+    while (2 * size * sizeof(Bucket) <= budget) {
+        size *= 2;
+    }
+
+    m_buckets.reset(new Bucket[size]);
+    m_mask = size - 1;
+    m_size_mb = std::max(megabytes, std::size_t{1});
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (std::uint64_t i = 0; i <= m_mask; ++i) {
+        for (auto &e : m_buckets[i].entries) {
+            e.key.store(0, std::memory_order_relaxed);
+            e.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    m_generation.store(0);
+    reset_counters();
+}
+
+void TranspositionTable::new_search() {
+    m_generation.store((m_generation.load() + 1) & GENERATION_MASK);
+}
+
+std::uint64_t TranspositionTable::pack(int generation, int visits, int black_wins) {
+    return (static_cast<std::uint64_t>(generation) << 56) |
+               (static_cast<std::uint64_t>(visits) << 32) |
+               static_cast<std::uint32_t>(black_wins);
+}
+
+void TranspositionTable::unpack(std::uint64_t data, int &visits, int &black_wins) {
+    visits = static_cast<int>((data >> 32) & MAX_VISITS);
+    black_wins = static_cast<int>(data & 0xffffffff);
+}
+
+int TranspositionTable::get_generation(std::uint64_t data) {
+    return static_cast<int>(data >> 56);
+}
+
+TranspositionTable::Bucket &TranspositionTable::get_bucket(std::uint64_t hash) {
+    return m_buckets[hash & m_mask];
+}
+
+bool TranspositionTable::probe(std::uint64_t hash, int &visits, int &black_wins) {
+    m_probes.fetch_add(1, std::memory_order_relaxed);
+
+    auto &bucket = get_bucket(hash);
+    for (auto &e : bucket.entries) {
+        const auto data = e.data.load(std::memory_order_relaxed);
+        const auto key = e.key.load(std::memory_order_relaxed);
+
+        if ((key ^ data) == hash && data != 0) {
+            unpack(data, visits, black_wins);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::update(std::uint64_t hash, int black_result) {
+    auto &bucket = get_bucket(hash);
+    const int generation = m_generation.load(std::memory_order_relaxed);
+
+    Entry *victim = nullptr;
+    int victim_score = 0;
+
+    for (auto &e : bucket.entries) {
+        const auto data = e.data.load(std::memory_order_relaxed);
+        const auto key = e.key.load(std::memory_order_relaxed);
+
+        int visits, black_wins;
+        unpack(data, visits, black_wins);
+
+        if ((key ^ data) == hash) {
+            // Racing updates may lose a result. It is only a statistic.
+            visits += 1;
+            black_wins += black_result;
+            if (visits > MAX_VISITS) {
+                // Keep the mean.
+                visits /= 2;
+                black_wins /= 2;
+            }
+            const auto new_data = pack(generation, visits, black_wins);
+            e.data.store(new_data, std::memory_order_relaxed);
+            e.key.store(hash ^ new_data, std::memory_order_relaxed);
+            return;
+        }
+
+        // Replace the entry with the fewest visits, halved once per
+        // search of age. The empty entries have no visits.
+        const int age = (generation - get_generation(data)) & GENERATION_MASK;
+        const int score = visits >> std::min(age, 31);
+        if (victim == nullptr || score < victim_score) {
+            victim = &e;
+            victim_score = score;
+        }
+    }
+
+    const auto new_data = pack(generation, 1, black_result);
+    victim->data.store(new_data, std::memory_order_relaxed);
+    victim->key.store(hash ^ new_data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::reset_counters() {
+    m_probes.store(0);
+    m_hits.store(0);
+}
+
+std::uint64_t TranspositionTable::get_probes() const {
+    return m_probes.load();
+}
+
+std::uint64_t TranspositionTable::get_hits() const {
+    return m_hits.load();
+}
+
+std::size_t TranspositionTable::get_size_mb() const {
+    return m_size_mb;
+}
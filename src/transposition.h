@@ -0,0 +1,85 @@
+#ifndef TRANSPOSITION_H_INCLUDE
+#define TRANSPOSITION_H_INCLUDE
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// The fixed size hash table of playout statistics keyed by the position
+// hash. Many search threads probe and store it at the same time without
+// locks. Each entry stores the key XOR the data, so a torn entry written
+// by two threads fails the key check and reads as a miss. The entries
+// remember the search which wrote them last, so the stale entries of the
+// older searches are replaced first.
+class TranspositionTable {
+public:
+    TranspositionTable();
+
+    // Reallocate the table with the memory budget in megabytes. All
+    // entries are dropped.
+    void resize(std::size_t megabytes);
+
+    // Drop all entries and reset the counters.
+    void clear();
+
+    // Start a new search. The entries which are not updated in it age,
+    // and every search of age halves their visits when a replacement
+    // victim is picked.
+    void new_search();
+
+    // Return true and fill the statistics if the position is in the
+    // table. The wins are in half points from the view of black.
+    bool probe(std::uint64_t hash, int &visits, int &black_wins);
+
+    // Add one playout result of the position. The result is in half
+    // points from the view of black, 0 (loss), 1 (draw) or 2 (win).
+    void update(std::uint64_t hash, int black_result);
+
+    // Reset the probes and hits counters.
+    void reset_counters();
+
+    std::uint64_t get_probes() const;
+    std::uint64_t get_hits() const;
+    std::size_t get_size_mb() const;
+
+private:
+    static constexpr int BUCKET_SIZE = 4;
+
+    // The data is the generation in the top 8 bits, the visits in the
+    // next 24 bits and the black wins in the low 32 bits.
+    static constexpr int GENERATION_MASK = 0xff;
+    static constexpr int MAX_VISITS = (1 << 24) - 1;
+
+    struct Entry {
+        std::atomic<std::uint64_t> key;
+        std::atomic<std::uint64_t> data;
+    };
+
+    // One bucket is as large as a cache line.
+    struct Bucket {
+        Entry entries[BUCKET_SIZE];
+    };
+
+    static std::uint64_t pack(int generation, int visits, int black_wins);
+    static void unpack(std::uint64_t data, int &visits, int &black_wins);
+    static int get_generation(std::uint64_t data);
+
+    Bucket &get_bucket(std::uint64_t hash);
+
+    std::unique_ptr<Bucket[]> m_buckets;
+
+    std::uint64_t m_mask;
+
+    std::size_t m_size_mb;
+
+    std::atomic<std::uint64_t> m_probes;
+
+    std::atomic<std::uint64_t> m_hits;
+
+    // The generation of the current search. The table may be shared by
+    // the searches of several threads.
+    std::atomic<int> m_generation;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "zobrist.h"
+
+constexpr Zobrist::KEY Zobrist::INIT_SEED;
+constexpr Zobrist::KEY Zobrist::BLACK_TO_MOVE;
+
+std::array<std::array<Zobrist::KEY, Board::NUM_VERTICES>, 4> Zobrist::STATE;
+std::array<Zobrist::KEY, Board::NUM_VERTICES+2> Zobrist::KO_MOVE;
+
+// The splitmix64 generator. We use a fixed seed so that the keys are
+// the same in every run.
+static Zobrist::KEY splitmix64(Zobrist::KEY &seed) {
+    Zobrist::KEY z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void Zobrist::initialize() {
+    KEY seed = 0xabcdabcd12345678ULL;
+
+    for (auto &keys : STATE) {
+        for (auto &k : keys) {
+            k = splitmix64(seed);
+        }
+    }
+    for (auto &k : KO_MOVE) {
+        k = splitmix64(seed);
+    }
+    KO_MOVE[Board::NULL_VERTEX] = 0ULL;
+}
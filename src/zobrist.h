@@ -0,0 +1,31 @@
+#ifndef ZOBRIST_H_INCLUDE
+#define ZOBRIST_H_INCLUDE
+
+#include <array>
+#include <cstdint>
+
+#include "board.h"
+
+class Zobrist {
+public:
+    using KEY = std::uint64_t;
+
+    // The hash of the empty set.
+    static constexpr KEY INIT_SEED = 0x1234567887654321ULL;
+
+    // XOR this key when black is the side to move.
+    static constexpr KEY BLACK_TO_MOVE = 0xabcdabcdabcdabcdULL;
+
+    // The keys per vertex state (black/white/empty/invalid).
+    static std::array<std::array<KEY, Board::NUM_VERTICES>, 4> STATE;
+
+    // The keys per ko move. The NULL_VERTEX key is zero, so a board
+    // without ko has the same key as its positional hash.
+    static std::array<KEY, Board::NUM_VERTICES+2> KO_MOVE;
+
+    // Fill the tables. It should be called once before any board is
+    // created.
+    static void initialize();
+};
+
+#endif